@@ -17,6 +17,7 @@
 #include <string.h>
 
 // EPICS includes
+#include <epicsAtomic.h>
 #include <epicsExit.h>
 #include <epicsExport.h>
 #include <epicsStdio.h>
@@ -59,6 +60,27 @@ extern "C" int ADUVCConfig(const char* portName, const char* serialOrProductID)
     return asynSuccess;
 }
 
+// Drivers created by ADUVCConfig, most recent first
+static ADUVC* pFirstDriver = NULL;
+
+/*
+ * External function that dumps the flight recorder of an ADUVC driver to a file, in the format
+ * described in ADUVCRecorder.h. Called from the IOC shell.
+ *
+ * @params[in]: portName    -> port of the driver
+ * @params[in]: fileName    -> file to write
+ * @params[in]: seconds     -> how far back to go, everything recorded if 0 or less
+ * @return: status
+ */
+extern "C" int ADUVCDumpRecorder(const char* portName, const char* fileName, double seconds) {
+    ADUVC* pUVC = ADUVC::findDriver(portName);
+    if (pUVC == NULL) {
+        printf("ADUVCDumpRecorder: no ADUVC driver on port %s\n", portName ? portName : "");
+        return asynError;
+    }
+    return pUVC->dumpRecorder(fileName, seconds);
+}
+
 /**
  * Callback function called when IOC is terminated.
  * Deletes created object and frees UVC context
@@ -70,6 +92,53 @@ static void exitCallbackC(void* pPvt) {
     delete (pUVC);
 }
 
+/**
+ * Function that finds the driver created by ADUVCConfig for a port
+ *
+ * @params[in]: portName -> port of the driver
+ * @return: the driver, or NULL if there is none on that port
+ */
+ADUVC* ADUVC::findDriver(const char* portName) {
+    if (portName == NULL) return NULL;
+    for (ADUVC* pUVC = pFirstDriver; pUVC != NULL; pUVC = pUVC->pNextDriver) {
+        if (strcmp(pUVC->portName, portName) == 0) return pUVC;
+    }
+    return NULL;
+}
+
+/**
+ * Function that dumps the flight recorder to a file, and reports the outcome in ADStatusMessage.
+ * May be called with or without the driver locked
+ *
+ * @params[in]: fileName    -> file to write
+ * @params[in]: seconds     -> how far back to go, everything recorded if 0 or less
+ * @return: asynSuccess, or asynError if the file could not be written
+ */
+asynStatus ADUVC::dumpRecorder(const char* fileName, double seconds) {
+    static const char* functionName = "dumpRecorder";
+    asynStatus status = asynSuccess;
+    const char* statusMessage = "Recorder dumped";
+
+    if (fileName == NULL || strlen(fileName) == 0) {
+        ERR("No file name to dump the flight recorder to");
+        statusMessage = "No recorder file name";
+        status = asynError;
+    } else {
+        int numRecords = this->recorder.dump(fileName, seconds, this->portName);
+        if (numRecords < 0) {
+            ERR_ARGS("Failed to write flight recorder to %s", fileName);
+            statusMessage = "Recorder dump failed";
+            status = asynError;
+        } else
+            INFO_ARGS("Wrote %d frame records to %s", numRecords, fileName);
+    }
+
+    lock();
+    updateStatus(statusMessage);
+    unlock();
+    return status;
+}
+
 /**
  * Function used to display UVC errors
  *
@@ -227,6 +296,7 @@ asynStatus ADUVC::readSupportedCameraFormats() {
 void ADUVC::populateCameraFormat(ADUVC_CamFormat_t* camFormat, uvc_format_desc_t* format_desc,
                                  uvc_frame_desc_t* frame_desc) {
     const char* functionName = "populateCameraFormat";
+    uvc_frame_format uvcFormat = uvc_get_format_desc_frame_format(format_desc);
 
     switch (format_desc->bDescriptorSubtype) {
         case UVC_VS_FORMAT_MJPEG:
@@ -235,9 +305,57 @@ void ADUVC::populateCameraFormat(ADUVC_CamFormat_t* camFormat, uvc_format_desc_t
             camFormat->colorMode = NDColorModeRGB1;
             break;
         case UVC_VS_FORMAT_UNCOMPRESSED:
-            camFormat->frameFormat = ADUVC_FrameUncompressed;
-            camFormat->dataType = NDUInt16;
-            camFormat->colorMode = NDColorModeMono;
+            // the GUID identifies the pixel layout, so pick the output that keeps its full depth
+            switch (uvcFormat) {
+                case UVC_FRAME_FORMAT_YUYV:
+                    camFormat->frameFormat = ADUVC_FrameYUYV;
+                    break;
+                case UVC_FRAME_FORMAT_UYVY:
+                    camFormat->frameFormat = ADUVC_FrameUYVY;
+                    break;
+                case UVC_FRAME_FORMAT_RGB:
+                    camFormat->frameFormat = ADUVC_FrameRGB;
+                    break;
+                case UVC_FRAME_FORMAT_NV12:
+                    camFormat->frameFormat = ADUVC_FrameNV12;
+                    break;
+                case UVC_FRAME_FORMAT_P010:
+                    camFormat->frameFormat = ADUVC_FrameP010;
+                    break;
+                case UVC_FRAME_FORMAT_GRAY8:
+                    camFormat->frameFormat = ADUVC_FrameGray8;
+                    break;
+                case UVC_FRAME_FORMAT_GRAY16:
+                    camFormat->frameFormat = ADUVC_FrameGray16;
+                    break;
+                case UVC_FRAME_FORMAT_Y10:
+                    camFormat->frameFormat = ADUVC_FrameY10;
+                    break;
+                case UVC_FRAME_FORMAT_Y12:
+                    camFormat->frameFormat = ADUVC_FrameY12;
+                    break;
+                case UVC_FRAME_FORMAT_Y10P:
+                    camFormat->frameFormat = ADUVC_FrameY10Packed;
+                    break;
+                case UVC_FRAME_FORMAT_Y12P:
+                    camFormat->frameFormat = ADUVC_FrameY12Packed;
+                    break;
+                case UVC_FRAME_FORMAT_BY8:
+                case UVC_FRAME_FORMAT_BA81:
+                case UVC_FRAME_FORMAT_SGRBG8:
+                case UVC_FRAME_FORMAT_SGBRG8:
+                case UVC_FRAME_FORMAT_SRGGB8:
+                case UVC_FRAME_FORMAT_SBGGR8:
+                    camFormat->frameFormat = ADUVC_FrameBayer8;
+                    break;
+                default:
+                    camFormat->frameFormat = ADUVC_FrameUncompressed;
+                    break;
+            }
+            if (!ADUVC_getNativeOutput(uvcFormat, &camFormat->dataType, &camFormat->colorMode)) {
+                camFormat->dataType = NDUInt16;
+                camFormat->colorMode = NDColorModeMono;
+            }
             break;
         default:
             ERR("Unsupported format desc!");
@@ -459,21 +577,127 @@ uvc_frame_format ADUVC::getFormatFromPV() {
             return UVC_FRAME_FORMAT_UYVY;
         case ADUVC_FrameUncompressed:
             return UVC_FRAME_FORMAT_UNCOMPRESSED;
+        case ADUVC_FrameY10:
+            return UVC_FRAME_FORMAT_Y10;
+        case ADUVC_FrameY12:
+            return UVC_FRAME_FORMAT_Y12;
+        case ADUVC_FrameY10Packed:
+            return UVC_FRAME_FORMAT_Y10P;
+        case ADUVC_FrameY12Packed:
+            return UVC_FRAME_FORMAT_Y12P;
+        case ADUVC_FrameBayer8:
+            return UVC_FRAME_FORMAT_BAYER8;
+        case ADUVC_FrameNV12:
+            return UVC_FRAME_FORMAT_NV12;
+        case ADUVC_FrameP010:
+            return UVC_FRAME_FORMAT_P010;
         default:
             ERR("Invalid frame format");
             return UVC_FRAME_FORMAT_UNKNOWN;
     }
 }
 
+/*
+ * Function that reads the PVs the acquisition pipeline depends on into acqConfig, and publishes
+ * a new version of the settings if they changed. Only called by the port thread, with the port
+ * locked.
+ *
+ * @return: void
+ */
+void ADUVC::updateConfig() {
+    ADUVC_AcqConfig_t* pConfig = &this->acqConfig;
+    int dataType = pConfig->dataType;
+    int colorMode = pConfig->colorMode;
+    int autoAdjust = pConfig->autoAdjust;
+    getIntegerParam(NDDataType, &dataType);
+    getIntegerParam(NDColorMode, &colorMode);
+    getIntegerParam(ADUVC_AutoAdjust, &autoAdjust);
+    getIntegerParam(ADImageMode, &pConfig->imageMode);
+    getIntegerParam(ADNumImages, &pConfig->numImages);
+    pConfig->streamFormat = getFormatFromPV();
+    pConfig->dataType = (NDDataType_t) dataType;
+    pConfig->colorMode = (NDColorMode_t) colorMode;
+    pConfig->autoAdjust = autoAdjust != 0;
+
+    // both copies are only written with memcpy, so their padding compares equal as well
+    if (memcmp(pConfig, &this->sharedConfig, sizeof(ADUVC_AcqConfig_t)) == 0) return;
+
+    epicsMutexLock(this->configLock);
+    memcpy(&this->sharedConfig, pConfig, sizeof(ADUVC_AcqConfig_t));
+    epicsAtomicIncrIntT(&this->configVersion);
+    epicsMutexUnlock(this->configLock);
+}
+
+/*
+ * Function that refreshes a pipeline thread's copy of the settings, if a new version was published
+ * since it was last copied. The lock is only taken when the settings changed.
+ *
+ * @params[out]: pConfig    -> copy of the settings owned by the calling thread
+ * @params[out]: pVersion   -> version of the settings held in pConfig
+ * @return: true if pConfig was refreshed, false if it was already up to date
+ */
+bool ADUVC::refreshConfig(ADUVC_AcqConfig_t* pConfig, int* pVersion) {
+    if (epicsAtomicGetIntT(&this->configVersion) == *pVersion) return false;
+
+    epicsMutexLock(this->configLock);
+    memcpy(pConfig, &this->sharedConfig, sizeof(ADUVC_AcqConfig_t));
+    *pVersion = this->configVersion;
+    epicsMutexUnlock(this->configLock);
+    return true;
+}
+
 //----------------------------------------------------------------------
 // UVC acquisition start and stop functions
 //----------------------------------------------------------------------
 
+/*
+ * Function that negotiates the smallest stream of a format whose frames cover a region of
+ * interest, which is then cropped out of each frame during conversion.
+ *
+ * @params[in]: imageFormat -> type of image format to use
+ * @params[in]: width       -> smallest frame width, ADMinX + ADSizeX
+ * @params[in]: height      -> smallest frame height, ADMinY + ADSizeY
+ * @params[in]: framerate   -> frame rate of the stream
+ * @return: UVC_SUCCESS, or UVC_ERROR_INVALID_MODE if no frame size of the format covers the region
+ */
+uvc_error_t ADUVC::negotiateRegionStream(uvc_frame_format imageFormat, int width, int height,
+                                         int framerate) {
+    static const char* functionName = "negotiateRegionStream";
+    int bestWidth = 0, bestHeight = 0;
+
+    uvc_streaming_interface_t* interfaces = this->pdeviceHandle->info->stream_ifs;
+    for (; interfaces != NULL; interfaces = interfaces->next) {
+        uvc_format_desc_t* formats = interfaces->format_descs;
+        for (; formats != NULL; formats = formats->next) {
+            uvc_frame_desc_t* frames = formats->frame_descs;
+            for (; frames != NULL; frames = frames->next) {
+                int frameWidth = frames->wWidth, frameHeight = frames->wHeight;
+                if (frameWidth < width || frameHeight < height) continue;
+                if (bestWidth > 0 && frameWidth * frameHeight >= bestWidth * bestHeight) continue;
+                if (uvc_get_stream_ctrl_format_size(pdeviceHandle, &deviceStreamCtrl, imageFormat,
+                                                    frameWidth, frameHeight,
+                                                    framerate) == UVC_SUCCESS) {
+                    bestWidth = frameWidth;
+                    bestHeight = frameHeight;
+                }
+            }
+        }
+    }
+
+    if (bestWidth == 0) return UVC_ERROR_INVALID_MODE;
+    INFO_ARGS("Streaming %dx%d frames for a region ending at %d, %d", bestWidth, bestHeight,
+              width, height);
+    return uvc_get_stream_ctrl_format_size(pdeviceHandle, &deviceStreamCtrl, imageFormat,
+                                           bestWidth, bestHeight, framerate);
+}
+
 /*
  * Function that starts the acquisition of the camera.
  * In the case of UVC devices, a function is called to first negotiate a stream with the camera at
  * a particular resolution and frame rate. Then the uvc_start_streaming function is called, with a
- * function name being passed as a parameter as the callback function.
+ * function name being passed as a parameter as the callback function. ADSizeX and ADSizeY select
+ * the resolution; with an ADMinX/ADMinY offset, or a size the camera does not stream, the
+ * smallest resolution covering the region is streamed and the region is cropped from it.
  *
  * @params[in]: imageFormat -> type of image format to use
  * @return: uvc_error_t -> return 0 if successful, otherwise return error code
@@ -485,14 +709,28 @@ uvc_error_t ADUVC::acquireStart(uvc_frame_format imageFormat) {
     int framerate;
     int xsize;
     int ysize;
+    int xmin;
+    int ymin;
     getIntegerParam(ADUVC_Framerate, &framerate);
     getIntegerParam(ADSizeX, &xsize);
     getIntegerParam(ADSizeY, &ysize);
+    getIntegerParam(ADMinX, &xmin);
+    getIntegerParam(ADMinY, &ymin);
+    ADUVC_Transform_t* pTransform = &this->acqConfig.transform;
+    pTransform->minX = xmin > 0 ? xmin : 0;
+    pTransform->minY = ymin > 0 ? ymin : 0;
+    pTransform->sizeX = xsize > 0 ? xsize : 0;
+    pTransform->sizeY = ysize > 0 ? ysize : 0;
 
     INFO_ARGS("Starting acquisition: x-size: %d, y-size %d, framerate %d", xsize, ysize, framerate);
 
-    deviceStatus = uvc_get_stream_ctrl_format_size(pdeviceHandle, &deviceStreamCtrl, imageFormat,
-                                                   xsize, ysize, framerate);
+    deviceStatus = UVC_ERROR_INVALID_MODE;
+    if (pTransform->minX == 0 && pTransform->minY == 0)
+        deviceStatus = uvc_get_stream_ctrl_format_size(pdeviceHandle, &deviceStreamCtrl,
+                                                       imageFormat, xsize, ysize, framerate);
+    if (deviceStatus != UVC_SUCCESS)
+        deviceStatus = negotiateRegionStream(imageFormat, pTransform->minX + xsize,
+                                             pTransform->minY + ysize, framerate);
 
     if (imageFormat == UVC_FRAME_FORMAT_UNCOMPRESSED) INFO("Opening uncompressed stream...");
 
@@ -500,11 +738,22 @@ uvc_error_t ADUVC::acquireStart(uvc_frame_format imageFormat) {
         ERR("Cannot start acquisition! Invalid frame format");
         deviceStatus = UVC_ERROR_NOT_SUPPORTED;
         reportUVCError(deviceStatus, functionName);
-        acquireStop();
+        setIntegerParam(ADAcquire, 0);
+        setIntegerParam(ADStatus, ADStatusIdle);
         callParamCallbacks();
         return deviceStatus;
     } else {
+        // frames still queued from an earlier acquisition are dropped, and the pipeline threads
+        // reset their counters when they see the first frame of this one
+        updateConfig();
+        epicsAtomicIncrIntT(&this->acquisition);
+
+        epicsAtomicSetIntT(&this->framesReceived, 0);
+        epicsAtomicSetIntT(&this->framesDropped, 0);
+        epicsAtomicSetIntT(&this->imagesConverted, 0);
         setIntegerParam(ADNumImagesCounter, 0);
+        setIntegerParam(ADUVC_FramesReceived, 0);
+        setIntegerParam(ADUVC_FramesDropped, 0);
         callParamCallbacks();
 
         // Here is where we initialize the stream and set the callback function
@@ -521,6 +770,7 @@ uvc_error_t ADUVC::acquireStart(uvc_frame_format imageFormat) {
             setIntegerParam(ADStatus, ADStatusIdle);
             callParamCallbacks();
         } else {
+            this->streaming = true;
             setIntegerParam(ADStatus, ADStatusAcquire);
             updateStatus("Started acquisition");
             callParamCallbacks();
@@ -532,19 +782,25 @@ uvc_error_t ADUVC::acquireStart(uvc_frame_format imageFormat) {
 
 /*
  * Function responsible for stopping aquisition of images from UVC camera
- * Calls uvc_stop_streaming function
+ * Calls uvc_stop_streaming function. Called with the port locked, by the port thread or by the
+ * publish thread once the images wanted are published, so it does nothing if the acquisition was
+ * already stopped.
  *
  * @return: void
  */
 void ADUVC::acquireStop() {
     static const char* functionName = "acquireStop";
 
+    if (!this->streaming) return;
+    this->streaming = false;
+
     INFO("Stopping acquisition...");
     // stop_streaming will block until last callback is processed.
     uvc_stop_streaming(pdeviceHandle);
 
-    // reset the validatedFrameSize flag
-    this->validatedFrameSize = false;
+    // frames and NDArrays still queued are dropped by the convert and publish threads, and the
+    // frame size is validated again on the next acquisition
+    epicsAtomicIncrIntT(&this->acquisition);
 
     // update PV values
     setIntegerParam(ADStatus, ADStatusIdle);
@@ -559,35 +815,109 @@ void ADUVC::acquireStop() {
 // UVC Image Processing and callback functions
 //-------------------------------------------------------
 
+/**
+ * Function that counts a received frame, and decides whether it is dropped. Only every
+ * UVCDecimation-th frame is considered, and one is dropped if it comes less than AcquirePeriod
+ * seconds after the scheduled time of the previous published frame. The schedule advances by whole
+ * periods so that the published rate does not drift, and restarts if the stream falls behind it.
+ *
+ * @return: true if the frame should be dropped, false if it should be published
+ */
+bool ADUVC::decimateFrame() {
+    // counters and the schedule restart with each acquisition, and the schedule when the period
+    // changes, in which case the next frame is published right away
+    int acquisition = epicsAtomicGetIntT(&this->acquisition);
+    if (acquisition != this->intakeAcquisition) {
+        this->intakeAcquisition = acquisition;
+        epicsAtomicSetIntT(&this->framesReceived, 0);
+        epicsAtomicSetIntT(&this->framesDropped, 0);
+        this->framesSinceDecimated = 0;
+        this->publishScheduled = false;
+    }
+    double acquirePeriod = this->intakeConfig.acquirePeriod;
+    if (refreshConfig(&this->intakeConfig, &this->intakeConfigVersion) &&
+        this->intakeConfig.acquirePeriod != acquirePeriod)
+        this->publishScheduled = false;
+    acquirePeriod = this->intakeConfig.acquirePeriod;
+
+    epicsAtomicIncrIntT(&this->framesReceived);
+
+    bool drop = ++this->framesSinceDecimated < this->intakeConfig.decimation;
+    if (!drop) {
+        this->framesSinceDecimated = 0;
+        if (acquirePeriod > 0) {
+            epicsTimeStamp now;
+            epicsTimeGetCurrent(&now);
+            double late = this->publishScheduled
+                              ? epicsTimeDiffInSeconds(&now, &this->nextPublishTime)
+                              : acquirePeriod;
+            if (late < 0)
+                drop = true;
+            else {
+                if (late >= acquirePeriod) this->nextPublishTime = now;
+                epicsTimeAddSeconds(&this->nextPublishTime, acquirePeriod);
+                this->publishScheduled = true;
+            }
+        }
+    }
+
+    // published frames post the counter along with the rest of the image parameters
+    if (drop && this->intakeConfig.counterRate <= 0) epicsEventSignal(this->counterEvent);
+    return drop;
+}
+
 /**
  * Function that is meant to adjust the NDDataType and NDColorMode. First check if current settings
  * are already valid. If not then attempt to adjust them to fit the frame recieved from the camera.
  * If able to adjust properly to fit the frame size, then set a validated tag to true - only compute
- * on the first frame on acquisition start.
+ * on the first frame on acquisition start. Adjustments are applied to the convert thread's copy of
+ * the settings right away, and reach the other threads through the PVs, which are written under
+ * the port lock as this runs on the convert thread.
  *
  * @params[in]: frame   -> pointer to frame recieved from the camera
  */
 void ADUVC::checkValidFrameSize(uvc_frame_t* frame) {
-    // if user has auto adjust toggled off, skip this.
-    int adjust;
-    getIntegerParam(ADUVC_AutoAdjust, &adjust);
+    ADUVC_AcqConfig_t* pConfig = &this->convertConfig;
 
-    if (adjust == 0) {
+    // if user has auto adjust toggled off, skip this.
+    if (!pConfig->autoAdjust) {
         this->validatedFrameSize = true;
         return;
     }
 
     const char* functionName = "checkValidFrameSize";
-    int reg_sizex, reg_sizey, colorMode, dataType;
-    getIntegerParam(NDColorMode, &colorMode);
-    getIntegerParam(NDDataType, &dataType);
-    getIntegerParam(ADSizeX, &reg_sizex);
-    getIntegerParam(ADSizeY, &reg_sizey);
+    int colorMode = pConfig->colorMode;
+    int dataType = pConfig->dataType;
+
+    // formats identified by their GUID only need a kernel for the selected output
+    NDDataType_t nativeDataType;
+    NDColorMode_t nativeColorMode;
+    if (ADUVC_getNativeOutput(frame->frame_format, &nativeDataType, &nativeColorMode)) {
+        if (ADUVC_findKernel(frame->frame_format, (NDDataType_t) dataType,
+                             (NDColorMode_t) colorMode) == NULL) {
+            ERR("Selected dtype and color mode incompatible, adjusting to the frame format...");
+            lock();
+            setIntegerParam(NDColorMode, nativeColorMode);
+            setIntegerParam(NDDataType, nativeDataType);
+            callParamCallbacks();
+            unlock();
+            pConfig->colorMode = nativeColorMode;
+            pConfig->dataType = nativeDataType;
+        }
+        this->validatedFrameSize = true;
+        return;
+    }
 
-    int computedBytes = reg_sizex * reg_sizey;
+    // ADSizeX and ADSizeY may be a region of interest inside the frame
+    int computedBytes = frame->width * frame->height;
     if ((NDDataType_t) dataType == NDUInt16 || (NDDataType_t) dataType == NDInt16)
         computedBytes = computedBytes * 2;
-    if ((NDColorMode_t) colorMode == NDColorModeRGB1) computedBytes = computedBytes * 3;
+    if ((NDColorMode_t) colorMode == NDColorModeRGB1 ||
+        (NDColorMode_t) colorMode == NDColorModeRGB2 ||
+        (NDColorMode_t) colorMode == NDColorModeRGB3)
+        computedBytes = computedBytes * 3;
+    else if ((NDColorMode_t) colorMode == NDColorModeYUV422)
+        computedBytes = computedBytes * 2;
 
     int num_bytes = frame->data_bytes;
     if (computedBytes == num_bytes) {
@@ -604,24 +934,29 @@ void ADUVC::checkValidFrameSize(uvc_frame_t* frame) {
     switch (res) {
         case 2:
             // num bytes / (xsize * ysize) = 2 means a 16 bit mono image. 2 bytes per pixel
-            setIntegerParam(NDColorMode, NDColorModeMono);
-            setIntegerParam(NDDataType, NDUInt16);
+            pConfig->colorMode = NDColorModeMono;
+            pConfig->dataType = NDUInt16;
             break;
         case 3:
             // num bytes / (xsize * ysize) = 3 means 8 bit rgb image. 1 byte per pixel per 3 colors.
-            setIntegerParam(NDColorMode, NDColorModeRGB1);
-            setIntegerParam(NDDataType, NDUInt8);
+            pConfig->colorMode = NDColorModeRGB1;
+            pConfig->dataType = NDUInt8;
             break;
         case 6:
             // num bytes / (xsize * ysize) = 6 means 16 bit rgb image. 2 bytes per pixel per 3
             // colors
-            setIntegerParam(NDColorMode, NDColorModeRGB1);
-            setIntegerParam(NDDataType, NDUInt16);
+            pConfig->colorMode = NDColorModeRGB1;
+            pConfig->dataType = NDUInt16;
             break;
         default:
             ERR("Couldn't validate frame size.");
             return;
     }
+    lock();
+    setIntegerParam(NDColorMode, pConfig->colorMode);
+    setIntegerParam(NDDataType, pConfig->dataType);
+    callParamCallbacks();
+    unlock();
 
     this->validatedFrameSize = true;
 }
@@ -644,85 +979,236 @@ void ADUVC::newFrameCallbackWrapper(uvc_frame_t* frame, void* ptr) {
     pPvt->newFrameCallback(frame, pPvt);
 }
 
+/*
+ * Function that selects the conversion kernel for the current stream format, NDDataType and
+ * NDColorMode, and the row kernel used to reorient frames. Called by the convert thread whenever
+ * the frame format or its copy of the settings changes, so that no per-frame dispatch on these is
+ * needed.
+ *
+ * @params[in]: frameFormat -> concrete format of the frames received from the camera
+ * @params[in]: width       -> width of the frames received from the camera
+ * @params[in]: height      -> height of the frames received from the camera
+ * @return: void
+ */
+void ADUVC::selectKernel(uvc_frame_format frameFormat, size_t width, size_t height) {
+    static const char* functionName = "selectKernel";
+    const ADUVC_AcqConfig_t* pConfig = &this->convertConfig;
+    const ADUVC_Transform_t* pTransform = &pConfig->transform;
+
+    this->kernelFrameFormat = frameFormat;
+    this->pKernel = ADUVC_findKernel(frameFormat, pConfig->dataType, pConfig->colorMode);
+    if (this->pKernel == NULL) {
+        ERR_ARGS("Unsupported combination of UVC format %d, data type %d and color mode %d",
+                 (int) frameFormat, (int) pConfig->dataType, (int) pConfig->colorMode);
+    } else {
+        DEBUG_ARGS("Selected conversion kernel %s", this->pKernel->name);
+    }
+
+    // a region is streamed as a larger frame it is cropped from, which these modes cannot do
+    bool cropped = pTransform->minX > 0 || pTransform->minY > 0 ||
+                   (pTransform->sizeX > 0 && pTransform->sizeX < width) ||
+                   (pTransform->sizeY > 0 && pTransform->sizeY < height);
+    this->pRowKernel = ADUVC_findRowKernel(this->pKernel);
+    if (this->pKernel != NULL && this->pRowKernel == NULL &&
+        (cropped || pTransform->binX > 1 || pTransform->binY > 1 || pTransform->reverseX ||
+         pTransform->reverseY || pTransform->rotation != ADUVC_Rotate0))
+        WARN("Region, binning, mirroring and rotation are not applied to this color mode");
+    if (this->pKernel != NULL && this->pRowKernel == NULL && pConfig->computeStats)
+        WARN("Statistics are not computed for this color mode");
+
+    // raw Bayer output is not binned either, the readbacks show the binning actually applied
+    NDBayerPattern_t bayerPattern;
+    bool binned = this->pRowKernel != NULL &&
+                  (this->pRowKernel->colorMode == NDColorModeRGB1 ||
+                   !ADUVC_getBayerPattern(frameFormat, pConfig->by8Pattern, &bayerPattern));
+    lock();
+    setIntegerParam(ADBinX, binned ? (int) pTransform->binX : 1);
+    setIntegerParam(ADBinY, binned ? (int) pTransform->binY : 1);
+    callParamCallbacks();
+    unlock();
+}
+
+/*
+ * Function that merges the statistics gathered by each band of a frame, and publishes them as
+ * PVs, as the histogram waveform, and as attributes of the NDArray. Called on the convert thread,
+ * which only holds the port lock while setting the PVs.
+ *
+ * @params[in]: pArray      -> NDArray the statistics were taken from
+ * @params[in]: numParts    -> number of bands in statsParts holding statistics of the frame
+ * @params[in]: pGeometry   -> placement of the frame in the NDArray
+ * @return: void
+ */
+void ADUVC::publishStats(NDArray* pArray, int numParts, const ADUVC_Geometry_t* pGeometry) {
+    ADUVC_Stats_t* pStats = &this->statsParts[0];
+    for (int i = 1; i < numParts; i++) ADUVC_mergeStats(pStats, &this->statsParts[i]);
+
+    ADUVC_StatsResult_t result;
+    ADUVC_finishStats(pStats, pGeometry, &result);
+    lock();
+    setDoubleParam(ADUVC_StatsTotal, result.total);
+    setDoubleParam(ADUVC_StatsMean, result.mean);
+    setDoubleParam(ADUVC_StatsMin, result.min);
+    setDoubleParam(ADUVC_StatsMax, result.max);
+    setDoubleParam(ADUVC_StatsCentroidX, result.centroidX);
+    setDoubleParam(ADUVC_StatsCentroidY, result.centroidY);
+    setDoubleParam(ADUVC_StatsSigmaX, result.sigmaX);
+    setDoubleParam(ADUVC_StatsSigmaY, result.sigmaY);
+    unlock();
+
+    NDAttributeList* pList = pArray->pAttributeList;
+    pList->add("StatsTotal", "Sum of luma", NDAttrFloat64, &result.total);
+    pList->add("StatsMean", "Mean luma", NDAttrFloat64, &result.mean);
+    pList->add("StatsMin", "Minimum luma", NDAttrFloat64, &result.min);
+    pList->add("StatsMax", "Maximum luma", NDAttrFloat64, &result.max);
+    pList->add("StatsCentroidX", "Luma centroid X", NDAttrFloat64, &result.centroidX);
+    pList->add("StatsCentroidY", "Luma centroid Y", NDAttrFloat64, &result.centroidY);
+    pList->add("StatsSigmaX", "Luma sigma X", NDAttrFloat64, &result.sigmaX);
+    pList->add("StatsSigmaY", "Luma sigma Y", NDAttrFloat64, &result.sigmaY);
+
+    // the histogram belongs to this thread, so its clients are called without the port lock
+    doCallbacksInt32Array((epicsInt32*) pStats->histogram, ADUVC_STATS_HISTOGRAM_BINS,
+                          ADUVC_StatsHistogram, 0);
+}
+
+/*
+ * Function that attaches where a converted frame came from to its NDArray, so that files written
+ * by plugins can be checked for dropped frames and latency offline. Everything comes from the
+ * trace of the frame, so no extra request is made to the camera.
+ *
+ * @params[out]: pArray -> NDArray the frame was converted into
+ * @params[in]:  pTrace -> trace of the frame, timestamped up to its conversion
+ * @return: void
+ */
+void ADUVC::addFrameAttributes(NDArray* pArray, const ADUVC_FrameTrace_t* pTrace) {
+    NDAttributeList* pList = pArray->pAttributeList;
+    epicsUInt32 sequence = pTrace->sequence;
+    epicsUInt32 pts = pTrace->pts;
+    epicsUInt32 scr = pTrace->scr;
+    epicsUInt32 payloadBytes = pTrace->bytes;
+    epicsUInt64 captureTime = pTrace->times.ns[ADUVC_TimeSwap];
+    epicsFloat64 decodeTime =
+        (pTrace->times.ns[ADUVC_TimeDecoded] - pTrace->times.ns[ADUVC_TimeAlloc]) / 1e6;
+
+    pList->add("UVCSequence", "libuvc frame sequence number", NDAttrUInt32, &sequence);
+    pList->add("UVCPTS", "Device presentation time stamp", NDAttrUInt32, &pts);
+    pList->add("UVCSCR", "Device source time clock", NDAttrUInt32, &scr);
+    pList->add("UVCPayloadBytes", "Bytes received, compressed for MJPEG", NDAttrUInt32,
+               &payloadBytes);
+    pList->add("UVCCaptureTime", "Monotonic time libuvc completed the frame, ns", NDAttrUInt64,
+               &captureTime);
+    pList->add("UVCDecodeTime", "Time spent converting the frame, ms", NDAttrFloat64,
+               &decodeTime);
+}
+
 /*
  * Function responsible for converting between a uvc_frame_t type image to
- * the EPICS area detector standard NDArray type. First, we convert any given uvc_frame to
- * the rgb format. This is because all of the supported uvc formats can be converted into this type,
- * simplyfying the conversion process. Then, the NDDataType is taken into account, and a scaling
- * factor is used
+ * the EPICS area detector standard NDArray type, using the kernel selected for the stream. See
+ * ADUVCKernels.cpp for the supported combinations of frame format, data type and color mode.
  *
  * @params[in]:  frame       -> frame collected from the uvc camera
  * @params[out]: pArray      -> output of function. NDArray conversion of uvc frame
- * @params[in]:  dataType    -> data type of NDArray output image
- * @params[in]:  colorMode   -> image color mode. So far only RGB1 is supported
+ * @params[in]:  pKernel     -> conversion kernel matching the frame and the NDArray
+ * @params[in]:  pGeometry   -> placement of the rows for binned or reoriented frames, or NULL.
+ * Statistics are only gathered from placed rows
  * @params[in]:  imBytes     -> number of bytes in the image
- * @return: void, but output into pArray
+ * @return: asynSuccess if pArray holds the frame and can be published, asynError otherwise
  */
-asynStatus ADUVC::uvc2NDArray(uvc_frame_t* frame, NDArray* pArray, NDDataType_t dataType,
-                              NDColorMode_t colorMode, size_t imBytes) {
+asynStatus ADUVC::uvc2NDArray(uvc_frame_t* frame, NDArray* pArray, const ADUVC_Kernel_t* pKernel,
+                              const ADUVC_Geometry_t* pGeometry, size_t imBytes) {
     static const char* functionName = "uvc2NDArray";
     asynStatus status = asynSuccess;
-    // if data is grayscale, we do not need to convert it, we just copy over the data.
-
-    if (colorMode == NDColorModeMono) {
-        if (frame->data_bytes != imBytes) {
-            ERR_ARGS("Error invalid frame size. Frame has %d bytes and array has %d bytes",
-                     (int) frame->data_bytes, (int) imBytes);
+    NDColorMode_t colorMode = pKernel->colorMode;
+    const ADUVC_AcqConfig_t* pConfig = &this->convertConfig;
+    bool withStats = pConfig->computeStats && pGeometry != NULL;
+    int numStatsParts = 0;
+
+    ADUVC_KernelArgs_t args;
+    args.frame = frame;
+    args.pOut = pArray->pData;
+    args.outBytes = imBytes;
+    args.width = frame->width;
+    args.height = frame->height;
+    args.inStep = 0;
+    args.firstRow = 0;
+    args.lastRow = frame->height;
+    args.decodeThreads = pConfig->decodeThreads;
+    args.pScratch = this->pScratchFrame;
+    args.outFirstRow = 0;
+    args.pGeometry = pGeometry;
+    args.band = 0;
+    args.pStats = NULL;
+    args.pPlaceBuffers = this->placeBuffers;
+    if (pGeometry != NULL) {
+        // only the rows of the region are split between the conversion threads
+        args.firstRow = pGeometry->roiY;
+        args.lastRow = pGeometry->roiY + pGeometry->roiHeight;
+    }
 
+    // the tables are owned by this thread, and rebuilt here when a different matrix is selected
+    if (this->yuvTablesMatrix != pConfig->colorMatrix) {
+        ADUVC_buildYUVTables(&this->yuvTables, pConfig->colorMatrix);
+        this->yuvTablesMatrix = pConfig->colorMatrix;
+    }
+    args.pYUVTables = &this->yuvTables;
+    args.bitShift = pConfig->bitShift;
+    args.by8Pattern = pConfig->by8Pattern;
+
+    if (pKernel->inBitsPerPixel > 0) {
+        // libuvc leaves the step unset for several packed formats
+        size_t rowBytes = ADUVC_rowBytes(frame->width, pKernel->inBitsPerPixel);
+        args.inStep = frame->step ? frame->step : rowBytes;
+        // the last row may stop short of the step
+        size_t expectedBytes = frame->height > 0 ? args.inStep * (frame->height - 1) + rowBytes : 0;
+        if (frame->data_bytes < expectedBytes) {
+            ERR_ARGS("Error invalid frame size. Frame has %d bytes, expected %d",
+                     (int) frame->data_bytes, (int) expectedBytes);
             status = asynError;
-        } else {
-            if (dataType == NDUInt8 || dataType == NDInt8) {
-                memcpy((unsigned char*) pArray->pData, (unsigned char*) frame->data, imBytes);
-            } else
-                memcpy((uint16_t*) pArray->pData, (uint16_t*) frame->data, imBytes);
         }
-    } else {
-        // otherwise we need to convert to a common type (rgb)
-        //  non grayscale images have 3 channels, so frame size * 3
-        uvc_frame_t* rgb = uvc_allocate_frame(frame->width * frame->height * 3);
-
-        if (!rgb) {
-            ERR("Unable to allocate frame!");
-            status = asynError;
-        } else {
-            // convert any uvc frame format to rgb
-            uvc_frame_format frameFormat = frame->frame_format;
-            switch (frameFormat) {
-                case UVC_FRAME_FORMAT_YUYV:
-                    deviceStatus = uvc_any2rgb(frame, rgb);
-                    break;
-                case UVC_FRAME_FORMAT_UYVY:
-                    deviceStatus = uvc_any2rgb(frame, rgb);
-                    break;
-                case UVC_FRAME_FORMAT_MJPEG:
-                    deviceStatus = uvc_mjpeg2rgb(frame, rgb);
-                    break;
-                case UVC_FRAME_FORMAT_RGB:
-                    deviceStatus = uvc_any2rgb(frame, rgb);
-                    break;
-                default:
-                    ERR("Unsupported UVC format!");
+    }
 
-                    uvc_free_frame(rgb);
-                    status = asynError;
+    if (status == asynSuccess) {
+        uvc_error_t convertStatus;
+        // binned or reoriented frames are converted row by row, each row written to its place
+        ADUVC_KernelFunc_t convert = pGeometry != NULL ? ADUVC_convertPlaced : pKernel->convert;
+        if (pKernel->inBitsPerPixel > 0 &&
+            this->convertPool.getNumThreads() != pConfig->convertThreads)
+            this->convertPool.setNumThreads(pConfig->convertThreads);
+
+        // each band or MJPEG stripe places its rows in buffers kept from frame to frame
+        if (pGeometry != NULL) {
+            int numBuffers = pKernel->inBitsPerPixel > 0 ? this->convertPool.getNumThreads()
+                                                         : pConfig->decodeThreads;
+            if (numBuffers > ADUVC_MAX_PLACE_BUFFERS) numBuffers = ADUVC_MAX_PLACE_BUFFERS;
+            if (!ADUVC_reservePlaceBuffers(this->placeBuffers, numBuffers, pGeometry)) {
+                ERR("Unable to allocate the row buffers of the region");
+                return asynError;
             }
+        }
 
-            if (status != asynError) {
-                if (deviceStatus < 0) {
-                    reportUVCError(deviceStatus, functionName);
-                    status = asynError;
-                } else {
-                    if (rgb->data_bytes != imBytes) {
-                        ERR_ARGS("Invalid frame sizeFrame has %d bytes and array has %d bytes\n",
-                                 (int) rgb->data_bytes, (int) imBytes);
-
-                        status = asynError;
-                    } else {
-                        memcpy(pArray->pData, rgb->data, imBytes);
-                    }
-                }
-                uvc_free_frame(rgb);
-            }
+        // each band of rows gathers its own statistics, merged once the frame is converted
+        if (withStats) {
+            numStatsParts = pKernel->inBitsPerPixel > 0 ? this->convertPool.getNumThreads() : 1;
+            for (int i = 0; i < numStatsParts; i++) ADUVC_clearStats(&this->statsParts[i]);
+            args.pStats = this->statsParts;
+        }
+
+        if (pKernel->inBitsPerPixel > 0) {
+            // packed formats are converted in row bands, spread over the thread pool
+            convertStatus = this->convertPool.run(convert, &args, pConfig->minBandRows);
+        } else if (pGeometry != NULL) {
+            convertStatus = ADUVC_convertPlaced(&args);
+        } else {
+            convertStatus = pKernel->convert(&args);
+        }
+        if (convertStatus == UVC_ERROR_NO_MEM) {
+            ERR_ARGS("Invalid frame size. Frame has %d bytes and array has %d bytes",
+                     (int) frame->data_bytes, (int) imBytes);
+            status = asynError;
+        } else if (convertStatus < 0) {
+            lock();
+            reportUVCError(convertStatus, functionName);
+            unlock();
+            status = asynError;
         }
     }
 
@@ -730,83 +1216,394 @@ asynStatus ADUVC::uvc2NDArray(uvc_frame_t* frame, NDArray* pArray, NDDataType_t
     if (status == asynSuccess) {
         pArray->pAttributeList->add("ColorMode", "Color Mode", NDAttrInt32, &colorMode);
 
-        // increment the array counter
-        int arrayCounter;
-        getIntegerParam(NDArrayCounter, &arrayCounter);
-        arrayCounter++;
-        setIntegerParam(NDArrayCounter, arrayCounter);
+        // raw Bayer frames carry their mosaic pattern, e.g. for NDPluginColorConvert
+        NDBayerPattern_t bayerPattern;
+        if (colorMode != NDColorModeRGB1 && colorMode != NDColorModeRGB2 &&
+            colorMode != NDColorModeRGB3 &&
+            ADUVC_getBayerPattern(frame->frame_format, pConfig->by8Pattern, &bayerPattern)) {
+            if (pGeometry != NULL) bayerPattern = ADUVC_orientBayerPattern(bayerPattern, pGeometry);
+            pArray->pAttributeList->add("BayerPattern", "Bayer Pattern", NDAttrInt32,
+                                        &bayerPattern);
+            lock();
+            setIntegerParam(NDBayerPattern, bayerPattern);
+            unlock();
+        }
 
-        // refresh PVs
-        callParamCallbacks();
+        if (withStats) publishStats(pArray, numStatsParts, pGeometry);
 
-        // Sends image to the ArrayDataPV
-        getAttributes(pArray->pAttributeList);
-        doCallbacksGenericPointer(pArray, NDArrayData, 0);
+        epicsAtomicIncrSizeT(&this->framesDecoded);
+        if (frame->frame_format == UVC_FRAME_FORMAT_MJPEG) {
+            epicsAtomicIncrSizeT(&this->mjpegFrames);
+            epicsAtomicAddSizeT(&this->mjpegBytes, frame->data_bytes);
+        }
     }
 
-    // Always free array whether successful or not
-    pArray->release();
     return status;
 }
 
 /*
- * Function that performs the callbacks onto new frames generated by the camera.
- * First, a new NDArray pointer is allocated, then the given uvc_frame pointer is converted
- * into this allocated NDArray. Then, based on the operating mode, the acquisition moves to the
- * next frame, or stops. The NDArray is passed on to the doCallbacksGenericPointer function.
+ * Function that takes in new frames generated by the camera, on the libuvc callback thread. Frames
+ * that are not decimated are copied to a free buffer and queued for the convert thread, so that
+ * this thread is never held up by conversion or by the NDArray callbacks. A frame is dropped if
+ * all buffers are in use.
  *
  * @params[in]: frame   -> uvc_frame recieved from the camera
  * @params[in]: ptr     -> void pointer with data from the frame
  * @return: void
  */
 void ADUVC::newFrameCallback(uvc_frame_t* frame, void* ptr) {
+    static const char* functionName = "newFrameCallback";
+    ADUVC_QueuedFrame_t item;
+    ADUVC_traceFrame(&item.trace, frame, ADUVC_monotonicNs());
+    ADUVC_PROBE2(frame_received, frame->sequence, frame->data_bytes);
+
+    // Drop unwanted frames before they are copied, validated, allocated or decoded
+    if (decimateFrame()) {
+        ADUVC_PROBE2(frame_dropped, frame->sequence, ADUVC_EventDecimated);
+        this->recorder.record(&item.trace, ADUVC_EventDecimated);
+        return;
+    }
+
+    if (epicsMessageQueueTryReceive(this->freeFrameQueue, &item.pFrame, sizeof(item.pFrame)) < 0) {
+        ADUVC_PROBE2(frame_dropped, frame->sequence, ADUVC_EventNoBuffer);
+        epicsAtomicIncrIntT(&this->framesDropped);
+        this->recorder.record(&item.trace, ADUVC_EventNoBuffer);
+        if (this->intakeConfig.counterRate <= 0) epicsEventSignal(this->counterEvent);
+        DEBUG("Dropped frame, all frame buffers are waiting for conversion");
+        return;
+    }
+
+    uvc_error_t copyStatus = uvc_duplicate_frame(frame, item.pFrame);
+    if (copyStatus != UVC_SUCCESS) {
+        ADUVC_PROBE2(frame_dropped, frame->sequence, ADUVC_EventCopyFailed);
+        // the port lock is never taken here, as acquireStop holds it while joining this thread
+        ERR_ARGS("Unable to copy frame: %s", uvc_strerror(copyStatus));
+        this->recorder.record(&item.trace, ADUVC_EventCopyFailed);
+        epicsMessageQueueSend(this->freeFrameQueue, &item.pFrame, sizeof(item.pFrame));
+        return;
+    }
+    updateTimeStamp(&item.timeStamp);
+    item.acquisition = this->intakeAcquisition;
+
+    // there are never more frames than free buffers, so the queue cannot be full
+    epicsMessageQueueSend(this->convertQueue, &item, sizeof(item));
+    ADUVC_PROBE2(frame_queued, frame->sequence, item.acquisition);
+}
+
+/*
+ * Body of the convert thread. Converts queued frames into NDArrays, and hands their buffers back
+ * to the frame callback. A NULL frame stops the thread, after being passed on to the publish
+ * thread.
+ */
+void ADUVC::convertThread() {
+    uint64_t lastCpuNs = ADUVC_threadCpuNs();
+    while (true) {
+        ADUVC_QueuedFrame_t item;
+        epicsMessageQueueReceive(this->convertQueue, &item, sizeof(item));
+        if (item.pFrame == NULL) {
+            ADUVC_QueuedArray_t stop;
+            memset(&stop, 0, sizeof(stop));
+            stop.acquisition = item.acquisition;
+            epicsMessageQueueSend(this->publishQueue, &stop, sizeof(stop));
+            break;
+        }
+
+        // frames of a stopped acquisition are dropped
+        if (item.acquisition == epicsAtomicGetIntT(&this->acquisition))
+            convertFrame(&item);
+        else
+            this->recorder.record(&item.trace, ADUVC_EventStale);
+        epicsMessageQueueSend(this->freeFrameQueue, &item.pFrame, sizeof(item.pFrame));
+        addThreadCpu(&this->convertCpuUs, &lastCpuNs);
+    }
+}
+
+/*
+ * Body of the publish thread. Publishes queued NDArrays until a NULL array stops the thread.
+ */
+void ADUVC::publishThread() {
+    uint64_t lastCpuNs = ADUVC_threadCpuNs();
+    while (true) {
+        ADUVC_QueuedArray_t item;
+        epicsMessageQueueReceive(this->publishQueue, &item, sizeof(item));
+        if (item.pArray == NULL) break;
+
+        // arrays of a stopped acquisition are dropped
+        if (item.acquisition == epicsAtomicGetIntT(&this->acquisition))
+            publishArray(&item);
+        else {
+            this->recorder.record(&item.trace, ADUVC_EventStale);
+            item.pArray->release();
+        }
+        addThreadCpu(&this->publishCpuUs, &lastCpuNs);
+    }
+    epicsEventSignal(this->pipelineDone);
+}
+
+/*
+ * Function that adds the CPU time the calling thread used since the last call to a total, in
+ * whole microseconds so that the remainder carries over to the next call.
+ *
+ * @params[in]:     pTotalUs    -> total of the thread, read by publishRates
+ * @params[in,out]: pLastCpuNs  -> CPU time of the thread already counted, in ns
+ * @return: void
+ */
+void ADUVC::addThreadCpu(size_t* pTotalUs, uint64_t* pLastCpuNs) {
+    size_t usedUs = (size_t) ((ADUVC_threadCpuNs() - *pLastCpuNs) / 1000);
+    epicsAtomicAddSizeT(pTotalUs, usedUs);
+    *pLastCpuNs += (uint64_t) usedUs * 1000;
+}
+
+/*
+ * Function that posts the counters, queue depths and NDArray size kept by the pipeline threads, and
+ * the log message counts, to their PVs. Only called by the counter thread, with the port locked:
+ * UVCCounterRate times per second, or whenever a frame signals it when the rate is 0, so that the
+ * frame callback thread never takes the port lock. The param library only posts values that
+ * changed, so the size is published when it changes.
+ *
+ * @return: void
+ */
+void ADUVC::flushCounters() {
+    setIntegerParam(ADUVC_FramesReceived, epicsAtomicGetIntT(&this->framesReceived));
+    setIntegerParam(ADUVC_FramesDropped, epicsAtomicGetIntT(&this->framesDropped));
+    setIntegerParam(ADNumImagesCounter, epicsAtomicGetIntT(&this->imagesConverted));
+    setIntegerParam(NDArrayCounter, epicsAtomicGetIntT(&this->arrayCounter));
+    setIntegerParam(ADUVC_ConvertQueued, epicsMessageQueuePending(this->convertQueue));
+    setIntegerParam(ADUVC_PublishQueued, epicsMessageQueuePending(this->publishQueue));
+    setIntegerParam(ADUVC_LogSuppressed, (int) this->logger.getSuppressed());
+    setIntegerParam(ADUVC_LogDropped, (int) this->logger.getDropped());
+
+    // the size is left alone until a frame has been converted
+    int arraySize = epicsAtomicGetIntT(&this->arraySize);
+    if (arraySize > 0) {
+        setIntegerParam(NDArraySize, arraySize);
+        setIntegerParam(NDArraySizeX, epicsAtomicGetIntT(&this->arraySizeX));
+        setIntegerParam(NDArraySizeY, epicsAtomicGetIntT(&this->arraySizeY));
+    }
+    callParamCallbacks();
+}
+
+/*
+ * Function that publishes the median, 99th percentile and maximum latency of each stage over
+ * recent published frames, and their histograms. Called with the port locked.
+ *
+ * @return: void
+ */
+void ADUVC::publishLatency() {
+    for (int stage = 0; stage < ADUVC_NUM_LATENCY_STAGES; stage++) {
+        ADUVC_LatencySummary_t summary;
+        epicsInt32 histogram[ADUVC_LATENCY_BINS];
+        this->latency.summarize(stage, &summary, histogram);
+        setDoubleParam(ADUVC_LatencyP50[stage], summary.p50);
+        setDoubleParam(ADUVC_LatencyP99[stage], summary.p99);
+        setDoubleParam(ADUVC_LatencyMax[stage], summary.max);
+        doCallbacksInt32Array(histogram, ADUVC_LATENCY_BINS, ADUVC_LatencyHistogram[stage], 0);
+    }
+}
+
+/*
+ * Function that publishes the rates of the USB stream, of conversion and of publication, the
+ * average size of MJPEG frames and the CPU usage of each thread, from the totals counted since the
+ * last call. Comparing the USB frame rate with the decode and publish rates tells whether a camera
+ * is limited by the bus, by conversion or by the plugins, and the CPU usage which thread is the
+ * bottleneck. CPU usage is in percent of one core. Called with the port locked.
+ *
+ * @params[in]: seconds -> time since the last call, 0 to only record the totals
+ * @return: void
+ */
+void ADUVC::publishRates(double seconds) {
+    ADUVC_RateTotals_t totals;
+    memset(&totals, 0, sizeof(totals));
+    if (this->pdeviceHandle != NULL) {
+        uvc_get_stream_counters(this->pdeviceHandle, &totals.usbBytes, &totals.usbFrames);
+        uvc_get_thread_cpu(this->pdeviceHandle, &totals.eventCpuNs, &totals.callbackCpuNs,
+                           &totals.decodeCpuNs);
+    }
+    totals.convertCpuUs = epicsAtomicGetSizeT(&this->convertCpuUs);
+    totals.workerCpuUs = this->convertPool.getCpuUs();
+    totals.publishCpuUs = epicsAtomicGetSizeT(&this->publishCpuUs);
+    totals.decoded = epicsAtomicGetSizeT(&this->framesDecoded);
+    totals.published = epicsAtomicGetSizeT(&this->framesPublished);
+    totals.mjpegFrames = epicsAtomicGetSizeT(&this->mjpegFrames);
+    totals.mjpegBytes = epicsAtomicGetSizeT(&this->mjpegBytes);
+
+    if (seconds > 0) {
+        const ADUVC_RateTotals_t* pLast = &this->lastTotals;
+        setDoubleParam(ADUVC_USBByteRate, (totals.usbBytes - pLast->usbBytes) / seconds / 1e6);
+        setDoubleParam(ADUVC_USBFrameRate, (totals.usbFrames - pLast->usbFrames) / seconds);
+        setDoubleParam(ADUVC_DecodeRate, (totals.decoded - pLast->decoded) / seconds);
+        setDoubleParam(ADUVC_PublishRate, (totals.published - pLast->published) / seconds);
+
+        // the size is kept while no MJPEG frame is converted
+        size_t mjpegFrames = totals.mjpegFrames - pLast->mjpegFrames;
+        if (mjpegFrames > 0)
+            setDoubleParam(ADUVC_MJPEGSize,
+                           (totals.mjpegBytes - pLast->mjpegBytes) / (double) mjpegFrames / 1e3);
+
+        // libuvc totals restart from 0 when a device is opened again
+        double nsPercent = seconds * 1e7, usPercent = seconds * 1e4;
+        if (totals.eventCpuNs >= pLast->eventCpuNs)
+            setDoubleParam(ADUVC_CPUEvent, (totals.eventCpuNs - pLast->eventCpuNs) / nsPercent);
+        if (totals.callbackCpuNs >= pLast->callbackCpuNs)
+            setDoubleParam(ADUVC_CPUCallback,
+                           (totals.callbackCpuNs - pLast->callbackCpuNs) / nsPercent);
+        setDoubleParam(ADUVC_CPUConvert, (totals.convertCpuUs - pLast->convertCpuUs) / usPercent);
+        if (totals.decodeCpuNs >= pLast->decodeCpuNs)
+            setDoubleParam(ADUVC_CPUWorkers,
+                           (totals.workerCpuUs - pLast->workerCpuUs) / usPercent +
+                               (totals.decodeCpuNs - pLast->decodeCpuNs) / nsPercent);
+        setDoubleParam(ADUVC_CPUPublish, (totals.publishCpuUs - pLast->publishCpuUs) / usPercent);
+    }
+    this->lastTotals = totals;
+}
+
+/*
+ * Body of the counter thread. Posts the pipeline counters UVCCounterRate times per second with the
+ * port locked, so that PV monitors and the port lock are not hit for every frame, and the latency
+ * and throughput PVs every ADUVC_MONITOR_PERIOD seconds. With a rate of 0 the counters are posted
+ * each time a pipeline thread signals a frame, as fast as the thread is woken.
+ */
+void ADUVC::counterThread() {
+    uint64_t nextMonitor = ADUVC_monotonicNs();
+    uint64_t lastMonitor = 0;
+    double wait = 0;
+    while (true) {
+        if (wait > 0) epicsEventWaitWithTimeout(this->counterEvent, wait);
+
+        lock();
+        if (this->counterExit) {
+            unlock();
+            break;
+        }
+        double counterRate = this->acqConfig.counterRate;
+        flushCounters();
+
+        uint64_t now = ADUVC_monotonicNs();
+        if (now >= nextMonitor) {
+            publishLatency();
+            publishRates(lastMonitor > 0 ? (now - lastMonitor) / 1e9 : 0);
+            callParamCallbacks();
+            lastMonitor = now;
+            nextMonitor = now + (uint64_t) (ADUVC_MONITOR_PERIOD * 1e9);
+        }
+        unlock();
+
+        // sleep until the next update of either, or until the rate changes
+        wait = (nextMonitor - now) / 1e9;
+        if (counterRate > 0 && 1.0 / counterRate < wait) wait = 1.0 / counterRate;
+    }
+    epicsEventSignal(this->counterDone);
+}
+
+void ADUVC::convertThreadC(void* pPvt) { ((ADUVC*) pPvt)->convertThread(); }
+
+void ADUVC::publishThreadC(void* pPvt) { ((ADUVC*) pPvt)->publishThread(); }
+
+void ADUVC::counterThreadC(void* pPvt) { ((ADUVC*) pPvt)->counterThread(); }
+
+/*
+ * Function that converts a frame into a new NDArray on the convert thread, and queues it for the
+ * publish thread. Single and multiple image modes only convert the images they still need. Blocks
+ * while the publish queue is full, in which case the frame callback drops frames instead.
+ *
+ * @params[in]: pItem   -> copy of the uvc_frame recieved from the camera, with the time it was
+ * received, its trace so far and the acquisition it belongs to
+ * @return: void
+ */
+void ADUVC::convertFrame(ADUVC_QueuedFrame_t* pItem) {
+    uvc_frame_t* frame = pItem->pFrame;
+    int acquisition = pItem->acquisition;
     NDArray* pArray;
     int dataType;
-    int operatingMode;
     int colorMode;
     int ndims;
+    static const char* functionName = "convertFrame";
+    const ADUVC_AcqConfig_t* pConfig = &this->convertConfig;
+
+    // the image count and frame size validation restart with each acquisition
+    if (acquisition != this->convertAcquisition) {
+        this->convertAcquisition = acquisition;
+        epicsAtomicSetIntT(&this->imagesConverted, 0);
+        this->validatedFrameSize = false;
+    }
+    bool reselect = refreshConfig(&this->convertConfig, &this->convertConfigVersion) ||
+                    frame->frame_format != this->kernelFrameFormat;
 
-    // TODO: Timestamps for images
-    // epicsTimeStamp currentTime;
-    static const char* functionName = "newFrameCallback";
+    // single and multiple image modes only convert the images they still need
+    if ((pConfig->imageMode == ADImageSingle && this->imagesConverted >= 1) ||
+        (pConfig->imageMode == ADImageMultiple && this->imagesConverted >= pConfig->numImages)) {
+        this->recorder.record(&pItem->trace, ADUVC_EventImageLimit);
+        return;
+    }
 
     // Check to see if frame size matches.
     // If not, adjust color mode and data type to try and fit frame.
     // **ONLY FOR UNCOMPRESSED FRAMES - otherwise byte sizes will not match **
-    if (!this->validatedFrameSize && getFormatFromPV() == UVC_FRAME_FORMAT_UNCOMPRESSED)
+    if (!this->validatedFrameSize && pConfig->streamFormat != UVC_FRAME_FORMAT_MJPEG) {
         checkValidFrameSize(frame);
-
-    getIntegerParam(NDColorMode, &colorMode);
-    getIntegerParam(NDDataType, &dataType);
-
-    if ((NDColorMode_t) colorMode == NDColorModeMono)
-        ndims = 2;
-    else
-        ndims = 3;
-
-    size_t dims[ndims];
-    if (ndims == 2) {
-        dims[0] = frame->width;
-        dims[1] = frame->height;
-    } else {
-        dims[0] = 3;
-        dims[1] = frame->width;
-        dims[2] = frame->height;
+        reselect = true;
     }
+    if (reselect) selectKernel(frame->frame_format, frame->width, frame->height);
 
-    getIntegerParam(ADImageMode, &operatingMode);
-
-    // allocate memory for a new NDArray, and set pArray to a pointer for this memory
-    this->pArrays[0] = pNDArrayPool->alloc(ndims, dims, (NDDataType_t) dataType, 0, NULL);
+    const ADUVC_Kernel_t* pKernel = this->pKernel;
+    if (pKernel == NULL) {
+        ERR("No conversion kernel for the current format, data type and color mode");
+        this->recorder.record(&pItem->trace, ADUVC_EventConvertFailed);
+        return;
+    }
+    colorMode = pKernel->colorMode;
+    dataType = pKernel->dataType;
+
+    // size of the NDArray after binning, with width and height swapped by a 90 or 270 degree
+    // rotation. Rows are also placed one by one when statistics are gathered from them
+    ADUVC_Geometry_t geometry;
+    bool placed = ADUVC_setupGeometry(&geometry, pKernel, this->pRowKernel, frame->width,
+                                      frame->height, &pConfig->transform, pConfig->computeStats);
+    size_t width = placed ? geometry.outWidth : frame->width;
+    size_t height = placed ? geometry.outHeight : frame->height;
+
+    size_t dims[3];
+    switch ((NDColorMode_t) colorMode) {
+        case NDColorModeRGB1:
+            ndims = 3;
+            dims[0] = 3;
+            dims[1] = width;
+            dims[2] = height;
+            break;
+        case NDColorModeRGB2:
+            ndims = 3;
+            dims[0] = width;
+            dims[1] = 3;
+            dims[2] = height;
+            break;
+        case NDColorModeRGB3:
+            ndims = 3;
+            dims[0] = width;
+            dims[1] = height;
+            dims[2] = 3;
+            break;
+        case NDColorModeYUV422:
+            // packed UYVY, two bytes per pixel
+            ndims = 2;
+            dims[0] = width * 2;
+            dims[1] = height;
+            break;
+        default:
+            ndims = 2;
+            dims[0] = width;
+            dims[1] = height;
+    }
 
-    if (this->pArrays[0] != NULL) {
-        pArray = this->pArrays[0];
-    } else {
+    // allocate memory for a new NDArray
+    pArray = pNDArrayPool->alloc(ndims, dims, (NDDataType_t) dataType, 0, NULL);
+    if (pArray == NULL) {
         ERR("Unable to allocate array!");
+        this->recorder.record(&pItem->trace, ADUVC_EventConvertFailed);
         return;
     }
+    pItem->trace.times.ns[ADUVC_TimeAlloc] = ADUVC_monotonicNs();
 
-    updateTimeStamp(&pArray->epicsTS);
+    pArray->epicsTS = pItem->timeStamp;
 
     int pixelSize = 1;
     switch (dataType) {
@@ -820,21 +1617,66 @@ void ADUVC::newFrameCallback(uvc_frame_t* frame, void* ptr) {
             break;
     }
 
-    // Update camera image parameters
+    // Update camera image parameters, posted with the counters
     size_t dataSize = dims[0] * dims[1] * pixelSize;
     if (ndims == 3) dataSize *= dims[2];
-    setIntegerParam(NDArraySize, (int) dataSize);
-    setIntegerParam(NDArraySizeX, frame->width);
-    setIntegerParam(NDArraySizeY, frame->height);
+    epicsAtomicSetIntT(&this->arraySize, (int) dataSize);
+    epicsAtomicSetIntT(&this->arraySizeX, (int) width);
+    epicsAtomicSetIntT(&this->arraySizeY, (int) height);
 
-    int numImages;
-    getIntegerParam(ADNumImagesCounter, &numImages);
-    numImages++;
-    setIntegerParam(ADNumImagesCounter, numImages);
-    pArray->uniqueId = numImages;
+    pArray->uniqueId = epicsAtomicIncrIntT(&this->imagesConverted);
+
+    // Copy data from our uvc frame into our NDArray, and hand it to the publish thread
+    if (uvc2NDArray(frame, pArray, pKernel, placed ? &geometry : NULL, dataSize) != asynSuccess) {
+        pArray->release();
+        this->recorder.record(&pItem->trace, ADUVC_EventConvertFailed);
+        return;
+    }
+    pItem->trace.times.ns[ADUVC_TimeDecoded] = ADUVC_monotonicNs();
+    addFrameAttributes(pArray, &pItem->trace);
+    ADUVC_QueuedArray_t item = {pArray, pItem->trace, acquisition};
+    epicsMessageQueueSend(this->publishQueue, &item, sizeof(item));
+}
 
-    // Copy data from our uvc frame into our NDArray
-    uvc2NDArray(frame, pArray, (NDDataType_t) dataType, (NDColorMode_t) colorMode, dataSize);
+/*
+ * Function that publishes a converted NDArray on the publish thread, then releases it. Based on
+ * the operating mode, the acquisition then moves on to the next frame, or stops.
+ *
+ * @params[in]: pItem   -> NDArray converted from a frame of the current acquisition, with the
+ * trace of the frame so far
+ * @return: void
+ */
+void ADUVC::publishArray(ADUVC_QueuedArray_t* pItem) {
+    static const char* functionName = "publishArray";
+    NDArray* pArray = pItem->pArray;
+    int numImages = pArray->uniqueId;
+    refreshConfig(&this->outputConfig, &this->outputConfigVersion);
+    int operatingMode = this->outputConfig.imageMode;
+
+    // increment the array counter
+    epicsAtomicIncrIntT(&this->arrayCounter);
+
+    // refresh PVs, unless the counter thread posts them at a fixed rate
+    if (this->outputConfig.counterRate <= 0) epicsEventSignal(this->counterEvent);
+
+    // Sends image to the ArrayDataPV. The port is unlocked during the callbacks, as plugins may
+    // block on their own locks
+    lock();
+    getAttributes(pArray->pAttributeList);
+    unlock();
+    doCallbacksGenericPointer(pArray, NDArrayData, 0);
+    pItem->trace.times.ns[ADUVC_TimePublished] = ADUVC_monotonicNs();
+    this->latency.addFrame(&pItem->trace.times);
+    this->recorder.record(&pItem->trace, ADUVC_EventPublished);
+    epicsAtomicIncrSizeT(&this->framesPublished);
+    pArray->release();
+
+    // the acquisition may have been stopped or restarted during the callbacks
+    lock();
+    if (pItem->acquisition != epicsAtomicGetIntT(&this->acquisition)) {
+        unlock();
+        return;
+    }
 
     // single shot mode stops after one images
     if (operatingMode == ADImageSingle) {
@@ -843,10 +1685,7 @@ void ADUVC::newFrameCallback(uvc_frame_t* frame, void* ptr) {
 
     // block shot mode stops once numImages reaches the number of desired images
     else if (operatingMode == ADImageMultiple) {
-        int desiredImages;
-        getIntegerParam(ADNumImages, &desiredImages);
-
-        if (numImages >= desiredImages) {
+        if (numImages >= this->outputConfig.numImages) {
             acquireStop();
         }
     }
@@ -857,6 +1696,7 @@ void ADUVC::newFrameCallback(uvc_frame_t* frame, void* ptr) {
 
         acquireStop();
     }
+    unlock();
 }
 
 /**
@@ -986,6 +1826,104 @@ asynStatus ADUVC::writeInt32(asynUser* pasynUser, epicsInt32 value) {
         updateCameraFormatDesc();
     else if (function == ADUVC_LogLevel)
         this->logLevel = (ADUVC_LogLevel_t) value;
+    else if (function == ADUVC_DecodeThreads) {
+        // MJPEG frames without restart markers are always decoded on a single thread
+        if (value < 1) {
+            value = 1;
+            setIntegerParam(ADUVC_DecodeThreads, value);
+        }
+        this->acqConfig.decodeThreads = value;
+    }
+
+    else if (function == ADUVC_ConvertThreads) {
+        if (value < 1 || value > ADUVC_MAX_CONVERT_THREADS) {
+            value = value < 1 ? 1 : ADUVC_MAX_CONVERT_THREADS;
+            setIntegerParam(ADUVC_ConvertThreads, value);
+        }
+        // the pool itself is resized by the convert thread, which owns it
+        this->acqConfig.convertThreads = value;
+    } else if (function == ADUVC_ColorMatrix) {
+        this->acqConfig.colorMatrix = (ADUVC_ColorMatrix_t) value;
+    } else if (function == ADUVC_BitShift) {
+        if (value < 0 || value > 8) {
+            value = value < 0 ? 0 : 8;
+            setIntegerParam(ADUVC_BitShift, value);
+        }
+        this->acqConfig.bitShift = value;
+    } else if (function == ADUVC_BY8Pattern) {
+        if (value < NDBayerRGGB || value > NDBayerBGGR) {
+            value = NDBayerBGGR;
+            setIntegerParam(ADUVC_BY8Pattern, value);
+        }
+        this->acqConfig.by8Pattern = (NDBayerPattern_t) value;
+    } else if (function == ADUVC_MinBandRows) {
+        if (value < 1) {
+            value = 1;
+            setIntegerParam(ADUVC_MinBandRows, value);
+        }
+        this->acqConfig.minBandRows = value;
+    } else if (function == ADUVC_StatsEnable) {
+        this->acqConfig.computeStats = value != 0;
+    } else if (function == ADUVC_Decimation) {
+        if (value < 1) {
+            value = 1;
+            setIntegerParam(ADUVC_Decimation, value);
+        }
+        this->acqConfig.decimation = value;
+    } else if (function == NDArrayCounter)
+        epicsAtomicSetIntT(&this->arrayCounter, value);
+    else if (function == ADUVC_LatencyReset && value == 1) {
+        this->latency.reset();
+        publishLatency();
+        setIntegerParam(ADUVC_LatencyReset, 0);
+    } else if (function == ADUVC_RecorderDump && value == 1) {
+        char fileName[MAX_FILENAME_LEN];
+        double seconds;
+        getStringParam(ADUVC_RecorderFile, sizeof(fileName), fileName);
+        getDoubleParam(ADUVC_RecorderSeconds, &seconds);
+        status = dumpRecorder(fileName, seconds);
+        setIntegerParam(ADUVC_RecorderDump, 0);
+    }
+
+    // The region of interest, binning and orientation are applied from the next frame on. A region
+    // outside of the frames streamed is clipped until acquisition is restarted
+    else if (function == ADMinX || function == ADMinY || function == ADSizeX ||
+             function == ADSizeY) {
+        ADUVC_Transform_t* pTransform = &this->acqConfig.transform;
+        size_t regionValue = value > 0 ? value : 0;
+        if (function == ADMinX)
+            pTransform->minX = regionValue;
+        else if (function == ADMinY)
+            pTransform->minY = regionValue;
+        else if (function == ADSizeX)
+            pTransform->sizeX = regionValue;
+        else
+            pTransform->sizeY = regionValue;
+    } else if (function == ADReverseX || function == ADReverseY || function == ADUVC_Rotation ||
+             function == ADBinX || function == ADBinY || function == ADUVC_BinMode) {
+        ADUVC_Transform_t* pTransform = &this->acqConfig.transform;
+        if (function == ADReverseX)
+            pTransform->reverseX = value != 0;
+        else if (function == ADReverseY)
+            pTransform->reverseY = value != 0;
+        else if (function == ADUVC_Rotation) {
+            if (value < ADUVC_Rotate0 || value > ADUVC_Rotate270) {
+                value = ADUVC_Rotate0;
+                setIntegerParam(ADUVC_Rotation, value);
+            }
+            pTransform->rotation = (ADUVC_Rotation_t) value;
+        } else if (function == ADUVC_BinMode)
+            pTransform->binAverage = value != 0;
+        else {
+            // only 1, 2 and 4 keep bins of rows inside a single MJPEG decode stripe
+            int bin = value >= 4 ? 4 : (value >= 2 ? 2 : 1);
+            if (bin != value) setIntegerParam(function, bin);
+            if (function == ADBinX)
+                pTransform->binX = bin;
+            else
+                pTransform->binY = bin;
+        }
+    }
 
     // Stop acqusition if image mode is changed
     else if (function == ADImageMode && acquiring == 1)
@@ -1033,6 +1971,9 @@ asynStatus ADUVC::writeInt32(asynUser* pasynUser, epicsInt32 value) {
         }
     }
 
+    // Hand changed settings to the acquisition pipeline, which applies them from its next frame
+    updateConfig();
+
     // Flush PV values
     callParamCallbacks();
 
@@ -1070,7 +2011,14 @@ asynStatus ADUVC::writeFloat64(asynUser* pasynUser, epicsFloat64 value) {
         deviceStatus = uvc_set_exposure_abs(this->pdeviceHandle, (uint32_t) value / 0.0001);
     } else if (function == ADGain)
         deviceStatus = uvc_set_gain(this->pdeviceHandle, (int) value);
-    else {
+    else if (function == ADAcquirePeriod) {
+        // the next frame is published right away, then at most one per period
+        this->acqConfig.acquirePeriod = value > 0 ? value : 0;
+    } else if (function == ADUVC_CounterRate) {
+        // 0 posts the counters with every frame
+        this->acqConfig.counterRate = value > 0 ? value : 0;
+        epicsEventSignal(this->counterEvent);
+    } else {
         if (function < ADUVC_FIRST_PARAM) {
             status = ADDriver::writeFloat64(pasynUser, value);
         }
@@ -1081,6 +2029,7 @@ asynStatus ADUVC::writeFloat64(asynUser* pasynUser, epicsFloat64 value) {
         status = asynError;
     }
 
+    updateConfig();
     callParamCallbacks();
     if (status) {
         ERR_ARGS("Failed to write %lf to function %d", value, function);
@@ -1131,6 +2080,25 @@ void ADUVC::report(FILE* fp, int details) {
         fprintf(fp, " Camera Framerate      ->      %d\n", framerate);
         fprintf(fp, " Image Width           ->      %d\n", width);
         fprintf(fp, " Image Height          ->      %d\n", height);
+        fprintf(fp, " Conversion Kernel     ->      %s\n",
+                this->pKernel != NULL ? this->pKernel->name : "None");
+        fprintf(fp, " Log Suppressed        ->      %lu\n",
+                (unsigned long) this->logger.getSuppressed());
+        fprintf(fp, " Log Dropped           ->      %lu\n",
+                (unsigned long) this->logger.getDropped());
+
+        // CPU usage over the last monitor period, in percent of one core
+        double cpuEvent, cpuCallback, cpuConvert, cpuWorkers, cpuPublish;
+        getDoubleParam(ADUVC_CPUEvent, &cpuEvent);
+        getDoubleParam(ADUVC_CPUCallback, &cpuCallback);
+        getDoubleParam(ADUVC_CPUConvert, &cpuConvert);
+        getDoubleParam(ADUVC_CPUWorkers, &cpuWorkers);
+        getDoubleParam(ADUVC_CPUPublish, &cpuPublish);
+        fprintf(fp, " CPU USB Events        ->      %.1f %%\n", cpuEvent);
+        fprintf(fp, " CPU Frame Callback    ->      %.1f %%\n", cpuCallback);
+        fprintf(fp, " CPU Convert           ->      %.1f %%\n", cpuConvert);
+        fprintf(fp, " CPU Decode Workers    ->      %.1f %%\n", cpuWorkers);
+        fprintf(fp, " CPU Publish           ->      %.1f %%\n", cpuPublish);
 
         fprintf(fp, " --------------------------------------------\n\n");
 
@@ -1150,8 +2118,11 @@ void ADUVC::report(FILE* fp, int details) {
  * @params[in]: serialOrProductID      -> serial number of device to connect to
  */
 ADUVC::ADUVC(const char* portName, const char* serialOrProductID)
-    : ADDriver(portName, 1, NUM_UVC_PARAMS, 0, 0, 0, 0, 0, 1, 0, 0) {
+    : ADDriver(portName, 1, NUM_UVC_PARAMS, 0, 0, asynInt32ArrayMask, asynInt32ArrayMask, 0, 1, 0,
+               0),
+      logger(driverName) {
     static const char* functionName = "ADUVC";
+    this->logger.start(pasynUserSelf);
 
     // Create PV Params
     createParam(ADUVC_UVCComplianceLevelString, asynParamInt32, &ADUVC_UVCComplianceLevel);
@@ -1180,6 +2151,58 @@ ADUVC::ADUVC(const char* portName, const char* serialOrProductID)
     createParam(ADUVC_PanSpeedString, asynParamInt32, &ADUVC_PanSpeed);
     createParam(ADUVC_TiltSpeedString, asynParamInt32, &ADUVC_TiltSpeed);
     createParam(ADUVC_PanTiltStepString, asynParamFloat64, &ADUVC_PanTiltStep);
+    createParam(ADUVC_DecodeThreadsString, asynParamInt32, &ADUVC_DecodeThreads);
+    createParam(ADUVC_ConvertThreadsString, asynParamInt32, &ADUVC_ConvertThreads);
+    createParam(ADUVC_MinBandRowsString, asynParamInt32, &ADUVC_MinBandRows);
+    createParam(ADUVC_ColorMatrixString, asynParamInt32, &ADUVC_ColorMatrix);
+    createParam(ADUVC_BitShiftString, asynParamInt32, &ADUVC_BitShift);
+    createParam(ADUVC_BY8PatternString, asynParamInt32, &ADUVC_BY8Pattern);
+    createParam(ADUVC_RotationString, asynParamInt32, &ADUVC_Rotation);
+    createParam(ADUVC_BinModeString, asynParamInt32, &ADUVC_BinMode);
+    createParam(ADUVC_DecimationString, asynParamInt32, &ADUVC_Decimation);
+    createParam(ADUVC_FramesReceivedString, asynParamInt32, &ADUVC_FramesReceived);
+    createParam(ADUVC_StatsEnableString, asynParamInt32, &ADUVC_StatsEnable);
+    createParam(ADUVC_StatsTotalString, asynParamFloat64, &ADUVC_StatsTotal);
+    createParam(ADUVC_StatsMeanString, asynParamFloat64, &ADUVC_StatsMean);
+    createParam(ADUVC_StatsMinString, asynParamFloat64, &ADUVC_StatsMin);
+    createParam(ADUVC_StatsMaxString, asynParamFloat64, &ADUVC_StatsMax);
+    createParam(ADUVC_StatsCentroidXString, asynParamFloat64, &ADUVC_StatsCentroidX);
+    createParam(ADUVC_StatsCentroidYString, asynParamFloat64, &ADUVC_StatsCentroidY);
+    createParam(ADUVC_StatsSigmaXString, asynParamFloat64, &ADUVC_StatsSigmaX);
+    createParam(ADUVC_StatsSigmaYString, asynParamFloat64, &ADUVC_StatsSigmaY);
+    createParam(ADUVC_StatsHistogramString, asynParamInt32Array, &ADUVC_StatsHistogram);
+    createParam(ADUVC_FramesDroppedString, asynParamInt32, &ADUVC_FramesDropped);
+    createParam(ADUVC_ConvertQueuedString, asynParamInt32, &ADUVC_ConvertQueued);
+    createParam(ADUVC_PublishQueuedString, asynParamInt32, &ADUVC_PublishQueued);
+    createParam(ADUVC_CounterRateString, asynParamFloat64, &ADUVC_CounterRate);
+    for (int stage = 0; stage < ADUVC_NUM_LATENCY_STAGES; stage++) {
+        const char* stageName = ADUVC_latencyStageName(stage);
+        char paramName[64];
+        epicsSnprintf(paramName, sizeof(paramName), ADUVC_LatencyHistogramString, stageName);
+        createParam(paramName, asynParamInt32Array, &ADUVC_LatencyHistogram[stage]);
+        epicsSnprintf(paramName, sizeof(paramName), ADUVC_LatencyP50String, stageName);
+        createParam(paramName, asynParamFloat64, &ADUVC_LatencyP50[stage]);
+        epicsSnprintf(paramName, sizeof(paramName), ADUVC_LatencyP99String, stageName);
+        createParam(paramName, asynParamFloat64, &ADUVC_LatencyP99[stage]);
+        epicsSnprintf(paramName, sizeof(paramName), ADUVC_LatencyMaxString, stageName);
+        createParam(paramName, asynParamFloat64, &ADUVC_LatencyMax[stage]);
+    }
+    createParam(ADUVC_LatencyResetString, asynParamInt32, &ADUVC_LatencyReset);
+    createParam(ADUVC_USBByteRateString, asynParamFloat64, &ADUVC_USBByteRate);
+    createParam(ADUVC_USBFrameRateString, asynParamFloat64, &ADUVC_USBFrameRate);
+    createParam(ADUVC_DecodeRateString, asynParamFloat64, &ADUVC_DecodeRate);
+    createParam(ADUVC_PublishRateString, asynParamFloat64, &ADUVC_PublishRate);
+    createParam(ADUVC_MJPEGSizeString, asynParamFloat64, &ADUVC_MJPEGSize);
+    createParam(ADUVC_RecorderDumpString, asynParamInt32, &ADUVC_RecorderDump);
+    createParam(ADUVC_RecorderFileString, asynParamOctet, &ADUVC_RecorderFile);
+    createParam(ADUVC_RecorderSecondsString, asynParamFloat64, &ADUVC_RecorderSeconds);
+    createParam(ADUVC_LogSuppressedString, asynParamInt32, &ADUVC_LogSuppressed);
+    createParam(ADUVC_LogDroppedString, asynParamInt32, &ADUVC_LogDropped);
+    createParam(ADUVC_CPUEventString, asynParamFloat64, &ADUVC_CPUEvent);
+    createParam(ADUVC_CPUCallbackString, asynParamFloat64, &ADUVC_CPUCallback);
+    createParam(ADUVC_CPUConvertString, asynParamFloat64, &ADUVC_CPUConvert);
+    createParam(ADUVC_CPUWorkersString, asynParamFloat64, &ADUVC_CPUWorkers);
+    createParam(ADUVC_CPUPublishString, asynParamFloat64, &ADUVC_CPUPublish);
 
     // sets libuvc version
     char uvcVersionString[25];
@@ -1195,6 +2218,45 @@ ADUVC::ADUVC(const char* portName, const char* serialOrProductID)
 
     setStringParam(NDDriverVersion, versionString);
 
+    // Scratch frame for conversion kernels that work in two passes. libuvc grows it as needed.
+    this->pScratchFrame = uvc_allocate_frame(0);
+
+    // Default settings of the acquisition pipeline, until the PVs are written
+    ADUVC_AcqConfig_t* pConfig = &this->acqConfig;
+    memset(pConfig, 0, sizeof(ADUVC_AcqConfig_t));
+    pConfig->streamFormat = UVC_FRAME_FORMAT_UNKNOWN;
+    pConfig->dataType = NDUInt8;
+    pConfig->colorMode = NDColorModeMono;
+    pConfig->imageMode = ADImageContinuous;
+    pConfig->numImages = 1;
+    pConfig->decimation = 1;
+    pConfig->transform.binX = 1;
+    pConfig->transform.binY = 1;
+    pConfig->transform.binAverage = true;
+    pConfig->transform.rotation = ADUVC_Rotate0;
+    pConfig->decodeThreads = 1;
+    pConfig->convertThreads = 1;
+    pConfig->minBandRows = 64;
+    pConfig->colorMatrix = ADUVC_ColorMatrixBT601Full;
+    pConfig->by8Pattern = NDBayerBGGR;
+    memcpy(&this->sharedConfig, pConfig, sizeof(ADUVC_AcqConfig_t));
+    this->configLock = epicsMutexMustCreate();
+
+    // Frame buffers and queues of the acquisition pipeline. The convert queue has room for every
+    // frame buffer and the item stopping the thread
+    this->freeFrameQueue = epicsMessageQueueCreate(ADUVC_FRAME_BUFFERS, sizeof(uvc_frame_t*));
+    this->convertQueue =
+        epicsMessageQueueCreate(ADUVC_FRAME_BUFFERS + 1, sizeof(ADUVC_QueuedFrame_t));
+    this->publishQueue =
+        epicsMessageQueueCreate(ADUVC_PUBLISH_QUEUE_SIZE, sizeof(ADUVC_QueuedArray_t));
+    this->pipelineDone = epicsEventMustCreate(epicsEventEmpty);
+    for (int i = 0; i < ADUVC_FRAME_BUFFERS; i++) {
+        uvc_frame_t* pFrame = uvc_allocate_frame(0);
+        if (pFrame != NULL) epicsMessageQueueSend(this->freeFrameQueue, &pFrame, sizeof(pFrame));
+    }
+    this->counterEvent = epicsEventMustCreate(epicsEventEmpty);
+    this->counterDone = epicsEventMustCreate(epicsEventEmpty);
+
     // Begin to establish connection
     bool connected = false;
     bool foundMatchingDeviceButBusy = false;
@@ -1265,12 +2327,30 @@ ADUVC::ADUVC(const char* portName, const char* serialOrProductID)
             getDeviceInformation();
         } else {
             free(this->pdevice);
+            this->pdevice = NULL;
             uvc_exit(this->pdeviceContext);
+            this->pdeviceContext = NULL;
         }
     } else {
         ERR("Failed to initialize UVC context!");
+        free(this->pdevice);
+        this->pdevice = NULL;
+        this->pdeviceContext = NULL;
     }
 
+    // the pipeline threads write params and use the device handle, so they are only started once
+    // the constructor is done with both
+    epicsThreadCreate("ADUVC_convert", epicsThreadPriorityMedium,
+                      epicsThreadGetStackSize(epicsThreadStackBig), ADUVC::convertThreadC, this);
+    epicsThreadCreate("ADUVC_publish", epicsThreadPriorityMedium,
+                      epicsThreadGetStackSize(epicsThreadStackBig), ADUVC::publishThreadC, this);
+    epicsThreadCreate("ADUVC_counters", epicsThreadPriorityLow,
+                      epicsThreadGetStackSize(epicsThreadStackSmall), ADUVC::counterThreadC, this);
+
+    // so that ADUVCDumpRecorder can find this driver by its port
+    this->pNextDriver = pFirstDriver;
+    pFirstDriver = this;
+
     // when epics is exited, delete the instance of this class
     epicsAtExit(exitCallbackC, this);
 }
@@ -1282,16 +2362,69 @@ ADUVC::~ADUVC() {
     static const char* functionName = "~ADUVC";
 
     INFO("Shutting down ADUVC driver...");
-    if (this->pdevice != NULL) {
+    for (ADUVC** ppUVC = &pFirstDriver; *ppUVC != NULL; ppUVC = &(*ppUVC)->pNextDriver) {
+        if (*ppUVC == this) {
+            *ppUVC = this->pNextDriver;
+            break;
+        }
+    }
+
+    // the stream and the pipeline threads are stopped while the device handle is still valid, as
+    // the publish thread may stop the acquisition itself
+    lock();
+    acquireStop();
+    unlock();
+    INFO("Stopping acquisition pipeline...");
+    epicsAtomicIncrIntT(&this->acquisition);
+    ADUVC_QueuedFrame_t stop;
+    stop.pFrame = NULL;
+    stop.acquisition = this->acquisition;
+    epicsMessageQueueSend(this->convertQueue, &stop, sizeof(stop));
+    epicsEventWait(this->pipelineDone);
+
+    // the counter thread samples the queues and the device handle, so it is stopped before they
+    // are destroyed
+    lock();
+    this->counterExit = true;
+    unlock();
+    epicsEventSignal(this->counterEvent);
+    epicsEventWait(this->counterDone);
+    epicsEventDestroy(this->counterEvent);
+    epicsEventDestroy(this->counterDone);
+
+    // the device is only closed once no request running under the port lock can reach it
+    lock();
+    uvc_device_handle_t* pHandle = this->pdeviceHandle;
+    uvc_device_t* pDevice = this->pdevice;
+    uvc_context_t* pContext = this->pdeviceContext;
+    this->pdeviceHandle = NULL;
+    this->pdevice = NULL;
+    this->pdeviceContext = NULL;
+    unlock();
+    if (pDevice != NULL) {
         INFO("Disconnecting from UVC device...");
-        uvc_close(pdeviceHandle);
-        uvc_unref_device(pdevice);
+        if (pHandle != NULL) uvc_close(pHandle);
+        uvc_unref_device(pDevice);
     }
-    if (this->pdeviceContext != NULL) {
+    if (pContext != NULL) {
         INFO("Exiting UVC context...");
-        uvc_exit(pdeviceContext);
+        uvc_exit(pContext);
     }
+
+    uvc_frame_t* pFrame;
+    while (epicsMessageQueueTryReceive(this->freeFrameQueue, &pFrame, sizeof(pFrame)) >= 0)
+        uvc_free_frame(pFrame);
+    epicsMessageQueueDestroy(this->freeFrameQueue);
+    epicsMessageQueueDestroy(this->convertQueue);
+    epicsMessageQueueDestroy(this->publishQueue);
+    epicsEventDestroy(this->pipelineDone);
+    epicsMutexDestroy(this->configLock);
+    if (this->pScratchFrame != NULL) uvc_free_frame(this->pScratchFrame);
+    ADUVC_freePlaceBuffers(this->placeBuffers, ADUVC_MAX_PLACE_BUFFERS);
     INFO("Done.");
+
+    // the messages above are written out before the driver is gone
+    this->logger.stop();
 }
 
 //-------------------------------------------------------------
@@ -1311,8 +2444,27 @@ static void configUVCCallFunc(const iocshArgBuf* args) { ADUVCConfig(args[0].sva
 /* information about the configuration function */
 static const iocshFuncDef configUVC = {"ADUVCConfig", 2, UVCConfigArgs};
 
+/* Dump recorder function arguments */
+static const iocshArg dumpUVCArg0 = {"Port name", iocshArgString};
+static const iocshArg dumpUVCArg1 = {"File name", iocshArgString};
+static const iocshArg dumpUVCArg2 = {"Seconds", iocshArgDouble};
+
+/* Array of dump recorder function arguments */
+static const iocshArg* const dumpUVCArgs[] = {&dumpUVCArg0, &dumpUVCArg1, &dumpUVCArg2};
+
+/* Function that calls the dump recorder function with its arguments */
+static void dumpUVCCallFunc(const iocshArgBuf* args) {
+    ADUVCDumpRecorder(args[0].sval, args[1].sval, args[2].dval);
+}
+
+/* information about the dump recorder function */
+static const iocshFuncDef dumpUVC = {"ADUVCDumpRecorder", 3, dumpUVCArgs};
+
 /* IOC register function */
-static void UVCRegister(void) { iocshRegister(&configUVC, configUVCCallFunc); }
+static void UVCRegister(void) {
+    iocshRegister(&configUVC, configUVCCallFunc);
+    iocshRegister(&dumpUVC, dumpUVCCallFunc);
+}
 
 /* external function for IOC register */
 extern "C" {
@@ -27,58 +27,65 @@
 
 #define SUPPORTED_FORMAT_DESC_BUFF 256
 
+// Number of frames that may be copied from libuvc and waiting for conversion, and of converted
+// NDArrays that may be waiting to be published
+#define ADUVC_FRAME_BUFFERS 4
+#define ADUVC_PUBLISH_QUEUE_SIZE 4
+
+// Seconds between updates of the latency and throughput PVs
+#define ADUVC_MONITOR_PERIOD 1.0
+
 // includes
 extern "C" {
 #include "libuvc/libuvc.h"
 #include "libuvc/libuvc_internal.h"
 }
 
-#include "ADDriver.h"
+#include <epicsEvent.h>
+#include <epicsMessageQueue.h>
+#include <epicsMutex.h>
 
-typedef enum ADUVC_LOG_LEVEL {
-    ADUVC_LOG_LEVEL_NONE = 0,
-    ADUVC_LOG_LEVEL_ERROR = 10,
-    ADUVC_LOG_LEVEL_WARNING = 20,
-    ADUVC_LOG_LEVEL_INFO = 30,
-    ADUVC_LOG_LEVEL_DEBUG = 40
-} ADUVC_LogLevel_t;
+#include "ADDriver.h"
+#include "ADUVCKernels.h"
+#include "ADUVCLatency.h"
+#include "ADUVCLog.h"
+#include "ADUVCRecorder.h"
+#include "ADUVCThreadPool.h"
+
+// Log message formatters. Messages are queued for the logging thread, and each call site is rate
+// limited, so that logging never holds up the thread it is called from
+#define ADUVC_LOG(level, fmt, ...)                                                \
+    do {                                                                          \
+        if (this->logLevel >= (level)) {                                          \
+            static ADUVC_LogSite_t logSite;                                       \
+            this->logger.post(&logSite, (level), functionName, fmt, __VA_ARGS__); \
+        }                                                                         \
+    } while (0)
 
 // Error message formatters
-#define ERR(msg)                                 \
-    if (this->logLevel >= ADUVC_LOG_LEVEL_ERROR) \
-        printf("ERROR | %s::%s: %s\n", driverName, functionName, msg);
-
-#define ERR_ARGS(fmt, ...)                       \
-    if (this->logLevel >= ADUVC_LOG_LEVEL_ERROR) \
-        printf("ERROR | %s::%s: " fmt "\n", driverName, functionName, __VA_ARGS__);
+#define ERR(msg) ADUVC_LOG(ADUVC_LOG_LEVEL_ERROR, "%s", msg)
+#define ERR_ARGS(fmt, ...) ADUVC_LOG(ADUVC_LOG_LEVEL_ERROR, fmt, __VA_ARGS__)
 
 // Warning message formatters
-#define WARN(msg)                                  \
-    if (this->logLevel >= ADUVC_LOG_LEVEL_WARNING) \
-        printf("WARNING | %s::%s: %s\n", driverName, functionName, msg);
-
-#define WARN_ARGS(fmt, ...)                        \
-    if (this->logLevel >= ADUVC_LOG_LEVEL_WARNING) \
-        printf("WARNING | %s::%s: " fmt "\n", driverName, functionName, __VA_ARGS__);
+#define WARN(msg) ADUVC_LOG(ADUVC_LOG_LEVEL_WARNING, "%s", msg)
+#define WARN_ARGS(fmt, ...) ADUVC_LOG(ADUVC_LOG_LEVEL_WARNING, fmt, __VA_ARGS__)
 
-// Info message formatters. Because there is no ASYN trace for info messages, we just use `printf`
-// here.
-#define INFO(msg)                               \
-    if (this->logLevel >= ADUVC_LOG_LEVEL_INFO) \
-        printf("INFO | %s::%s: %s\n", driverName, functionName, msg);
-
-#define INFO_ARGS(fmt, ...)                     \
-    if (this->logLevel >= ADUVC_LOG_LEVEL_INFO) \
-        printf("INFO | %s::%s: " fmt "\n", driverName, functionName, __VA_ARGS__);
+// Info message formatters
+#define INFO(msg) ADUVC_LOG(ADUVC_LOG_LEVEL_INFO, "%s", msg)
+#define INFO_ARGS(fmt, ...) ADUVC_LOG(ADUVC_LOG_LEVEL_INFO, fmt, __VA_ARGS__)
 
 // Debug message formatters
-#define DEBUG(msg)                               \
-    if (this->logLevel >= ADUVC_LOG_LEVEL_DEBUG) \
-        printf("DEBUG | %s::%s: %s\n", driverName, functionName, msg);
-
-#define DEBUG_ARGS(fmt, ...)                     \
-    if (this->logLevel >= ADUVC_LOG_LEVEL_DEBUG) \
-        printf("DEBUG | %s::%s: " fmt "\n", driverName, functionName, __VA_ARGS__);
+#define DEBUG(msg) ADUVC_LOG(ADUVC_LOG_LEVEL_DEBUG, "%s", msg)
+#define DEBUG_ARGS(fmt, ...) ADUVC_LOG(ADUVC_LOG_LEVEL_DEBUG, fmt, __VA_ARGS__)
+
+// Static tracepoints (USDT) of the aduvc provider, for perf and bpftrace. Compiled in with
+// WITH_USDT = YES, along with those of libuvc
+#ifdef UVC_USDT
+#include <sys/sdt.h>
+#define ADUVC_PROBE2(name, a, b) DTRACE_PROBE2(aduvc, name, a, b)
+#else
+#define ADUVC_PROBE2(name, a, b)
+#endif
 
 // PV String definitions
 #define ADUVC_UVCComplianceLevelString "UVC_COMPLIANCE"         // asynInt32
@@ -107,6 +114,52 @@ typedef enum ADUVC_LOG_LEVEL {
 #define ADUVC_PanSpeedString "UVC_PAN_SPEED"                    // asynInt32
 #define ADUVC_TiltSpeedString "UVC_TILT_SPEED"                  // asynInt32
 #define ADUVC_PanTiltStepString "UVC_PAN_TILT_STEP"             // asynFloat64
+#define ADUVC_DecodeThreadsString "UVC_DECODE_THREADS"          // asynInt32
+#define ADUVC_ConvertThreadsString "UVC_CONVERT_THREADS"        // asynInt32
+#define ADUVC_MinBandRowsString "UVC_MIN_BAND_ROWS"             // asynInt32
+#define ADUVC_ColorMatrixString "UVC_COLOR_MATRIX"              // asynInt32
+#define ADUVC_BitShiftString "UVC_BIT_SHIFT"                    // asynInt32
+#define ADUVC_BY8PatternString "UVC_BY8_PATTERN"                // asynInt32
+#define ADUVC_RotationString "UVC_ROTATION"                     // asynInt32
+#define ADUVC_BinModeString "UVC_BIN_MODE"                      // asynInt32
+#define ADUVC_DecimationString "UVC_DECIMATION"                 // asynInt32
+#define ADUVC_FramesReceivedString "UVC_FRAMES_RECEIVED"        // asynInt32
+#define ADUVC_StatsEnableString "UVC_STATS_ENABLE"              // asynInt32
+#define ADUVC_StatsTotalString "UVC_STATS_TOTAL"                // asynFloat64
+#define ADUVC_StatsMeanString "UVC_STATS_MEAN"                  // asynFloat64
+#define ADUVC_StatsMinString "UVC_STATS_MIN"                    // asynFloat64
+#define ADUVC_StatsMaxString "UVC_STATS_MAX"                    // asynFloat64
+#define ADUVC_StatsCentroidXString "UVC_STATS_CENTROID_X"       // asynFloat64
+#define ADUVC_StatsCentroidYString "UVC_STATS_CENTROID_Y"       // asynFloat64
+#define ADUVC_StatsSigmaXString "UVC_STATS_SIGMA_X"             // asynFloat64
+#define ADUVC_StatsSigmaYString "UVC_STATS_SIGMA_Y"             // asynFloat64
+#define ADUVC_StatsHistogramString "UVC_STATS_HISTOGRAM"        // asynInt32Array
+#define ADUVC_FramesDroppedString "UVC_FRAMES_DROPPED"          // asynInt32
+#define ADUVC_ConvertQueuedString "UVC_CONVERT_QUEUED"          // asynInt32
+#define ADUVC_PublishQueuedString "UVC_PUBLISH_QUEUED"          // asynInt32
+#define ADUVC_CounterRateString "UVC_COUNTER_RATE"              // asynFloat64
+
+// Latency PVs of each stage, with %s replaced by the name of the stage
+#define ADUVC_LatencyHistogramString "UVC_LAT_%s_HIST"          // asynInt32Array
+#define ADUVC_LatencyP50String "UVC_LAT_%s_P50"                 // asynFloat64
+#define ADUVC_LatencyP99String "UVC_LAT_%s_P99"                 // asynFloat64
+#define ADUVC_LatencyMaxString "UVC_LAT_%s_MAX"                 // asynFloat64
+#define ADUVC_LatencyResetString "UVC_LATENCY_RESET"            // asynInt32
+#define ADUVC_USBByteRateString "UVC_USB_BYTE_RATE"             // asynFloat64
+#define ADUVC_USBFrameRateString "UVC_USB_FRAME_RATE"           // asynFloat64
+#define ADUVC_DecodeRateString "UVC_DECODE_RATE"                // asynFloat64
+#define ADUVC_PublishRateString "UVC_PUBLISH_RATE"              // asynFloat64
+#define ADUVC_MJPEGSizeString "UVC_MJPEG_SIZE"                  // asynFloat64
+#define ADUVC_RecorderDumpString "UVC_RECORDER_DUMP"            // asynInt32
+#define ADUVC_RecorderFileString "UVC_RECORDER_FILE"            // asynOctet
+#define ADUVC_RecorderSecondsString "UVC_RECORDER_SECONDS"      // asynFloat64
+#define ADUVC_LogSuppressedString "UVC_LOG_SUPPRESSED"          // asynInt32
+#define ADUVC_LogDroppedString "UVC_LOG_DROPPED"                // asynInt32
+#define ADUVC_CPUEventString "UVC_CPU_EVENT"                    // asynFloat64
+#define ADUVC_CPUCallbackString "UVC_CPU_CALLBACK"              // asynFloat64
+#define ADUVC_CPUConvertString "UVC_CPU_CONVERT"                // asynFloat64
+#define ADUVC_CPUWorkersString "UVC_CPU_WORKERS"                // asynFloat64
+#define ADUVC_CPUPublishString "UVC_CPU_PUBLISH"                // asynFloat64
 
 /* enum for getting format from PV */
 typedef enum ADUVC_FRAME_FORMAT {
@@ -118,6 +171,13 @@ typedef enum ADUVC_FRAME_FORMAT {
     ADUVC_FrameGray16 = 4,
     ADUVC_FrameUYVY = 5,
     ADUVC_FrameUncompressed = 6,
+    ADUVC_FrameY10 = 7,
+    ADUVC_FrameY12 = 8,
+    ADUVC_FrameY10Packed = 9,
+    ADUVC_FrameY12Packed = 10,
+    ADUVC_FrameBayer8 = 11,
+    ADUVC_FrameNV12 = 12,
+    ADUVC_FrameP010 = 13,
 } ADUVC_FrameFormat_t;
 
 /* Struct for individual supported camera format - Used to auto read modes into dropdown for easier
@@ -134,6 +194,63 @@ typedef struct ADUVC_CAM_FORMAT {
 
 typedef enum ADUVC_CONNECTION_TYPE { UVC_SERIAL = 0, UVC_PRODUCT_ID = 1 } ADUVC_ConnectionType_t;
 
+/* Frame copied from libuvc, queued for the convert thread */
+typedef struct ADUVC_QUEUED_FRAME {
+    uvc_frame_t* pFrame;       // frame buffer, NULL to stop the thread
+    epicsTimeStamp timeStamp;  // time the frame was received
+    ADUVC_FrameTrace_t trace;  // sequence, size and times of the frame so far
+    int acquisition;           // acquisition the frame was received in
+} ADUVC_QueuedFrame_t;
+
+/* Converted NDArray, queued for the publish thread */
+typedef struct ADUVC_QUEUED_ARRAY {
+    NDArray* pArray;           // NDArray to publish, NULL to stop the thread
+    ADUVC_FrameTrace_t trace;  // sequence, size and times of the frame so far
+    int acquisition;           // acquisition the frame was received in
+} ADUVC_QueuedArray_t;
+
+/* Totals the throughput PVs are computed from */
+typedef struct ADUVC_RATE_TOTALS {
+    uint64_t usbBytes;   // payload bytes received by libuvc
+    uint64_t usbFrames;  // frames completed by libuvc
+    size_t decoded;      // frames converted into NDArrays
+    size_t published;    // NDArrays published
+    size_t mjpegFrames;  // MJPEG frames converted
+    size_t mjpegBytes;   // compressed bytes of the MJPEG frames converted
+
+    // CPU time of the threads working on the stream, in ns for the libuvc threads and in us for
+    // the driver's own
+    uint64_t eventCpuNs;     // libusb event handler thread
+    uint64_t callbackCpuNs;  // libuvc thread calling newFrameCallback
+    uint64_t decodeCpuNs;    // extra threads decoding stripes of MJPEG frames
+    size_t convertCpuUs;     // convert thread
+    size_t workerCpuUs;      // row band workers of the convert thread
+    size_t publishCpuUs;     // publish thread
+} ADUVC_RateTotals_t;
+
+/* Settings read by the acquisition pipeline. Each pipeline thread works from its own copy, taken
+ * when the driver publishes a new version, so that a frame is handled with consistent settings
+ * and without reading the parameter library */
+typedef struct ADUVC_ACQ_CONFIG {
+    uvc_frame_format streamFormat;    // format selected with UVCImageFormat
+    NDDataType_t dataType;            // NDArray data type
+    NDColorMode_t colorMode;          // NDArray color mode
+    bool autoAdjust;                  // fit the data type and color mode to the first frame
+    int imageMode;                    // ADImageMode
+    int numImages;                    // images to acquire in multiple mode
+    int decimation;                   // only every decimation-th frame is published
+    double acquirePeriod;             // minimum time between published frames, 0 for none
+    ADUVC_Transform_t transform;      // region, binning and orientation of the NDArray
+    bool computeStats;                // gather luma statistics while converting frames
+    int decodeThreads;                // maximum number of threads decoding one MJPEG frame
+    int convertThreads;               // threads converting one uncompressed frame
+    int minBandRows;                  // smallest band of rows worth giving to another thread
+    ADUVC_ColorMatrix_t colorMatrix;  // Y'CbCr to RGB matrix
+    int bitShift;                     // right shift applied to 16 bit greyscale samples
+    NDBayerPattern_t by8Pattern;      // mosaic pattern of BY8 frames, which UVC leaves undefined
+    double counterRate;               // rate counters are posted at, 0 to post them per frame
+} ADUVC_AcqConfig_t;
+
 /*
  * Class definition of the ADUVC driver. It inherits from the base ADDriver class
  *
@@ -152,6 +269,10 @@ class ADUVC : ADDriver {
     // Callback function envoked by the driver object through the wrapper
     void newFrameCallback(uvc_frame_t* frame, void* ptr);
 
+    // Functions that find the driver of a port, and dump its flight recorder to a file
+    static ADUVC* findDriver(const char* portName);
+    asynStatus dumpRecorder(const char* fileName, double seconds);
+
     // destructor. Disconnects from camera, deletes the object
     ~ADUVC();
 
@@ -183,32 +304,83 @@ class ADUVC : ADDriver {
     int ADUVC_PanSpeed;
     int ADUVC_TiltSpeed;
     int ADUVC_PanTiltStep;
-#define ADUVC_LAST_PARAM ADUVC_PanTiltStep
+    int ADUVC_DecodeThreads;
+    int ADUVC_ConvertThreads;
+    int ADUVC_MinBandRows;
+    int ADUVC_ColorMatrix;
+    int ADUVC_BitShift;
+    int ADUVC_BY8Pattern;
+    int ADUVC_Rotation;
+    int ADUVC_BinMode;
+    int ADUVC_Decimation;
+    int ADUVC_FramesReceived;
+    int ADUVC_StatsEnable;
+    int ADUVC_StatsTotal;
+    int ADUVC_StatsMean;
+    int ADUVC_StatsMin;
+    int ADUVC_StatsMax;
+    int ADUVC_StatsCentroidX;
+    int ADUVC_StatsCentroidY;
+    int ADUVC_StatsSigmaX;
+    int ADUVC_StatsSigmaY;
+    int ADUVC_StatsHistogram;
+    int ADUVC_FramesDropped;
+    int ADUVC_ConvertQueued;
+    int ADUVC_PublishQueued;
+    int ADUVC_CounterRate;
+    int ADUVC_LatencyHistogram[ADUVC_NUM_LATENCY_STAGES];
+    int ADUVC_LatencyP50[ADUVC_NUM_LATENCY_STAGES];
+    int ADUVC_LatencyP99[ADUVC_NUM_LATENCY_STAGES];
+    int ADUVC_LatencyMax[ADUVC_NUM_LATENCY_STAGES];
+    int ADUVC_LatencyReset;
+    int ADUVC_USBByteRate;
+    int ADUVC_USBFrameRate;
+    int ADUVC_DecodeRate;
+    int ADUVC_PublishRate;
+    int ADUVC_MJPEGSize;
+    int ADUVC_RecorderDump;
+    int ADUVC_RecorderFile;
+    int ADUVC_RecorderSeconds;
+    int ADUVC_LogSuppressed;
+    int ADUVC_LogDropped;
+    int ADUVC_CPUEvent;
+    int ADUVC_CPUCallback;
+    int ADUVC_CPUConvert;
+    int ADUVC_CPUWorkers;
+    int ADUVC_CPUPublish;
+#define ADUVC_LAST_PARAM ADUVC_CPUPublish
 
    private:
     // ----------------------------------------
     // UVC Variables
     //-----------------------------------------
 
-    ADUVC_LogLevel_t logLevel = ADUVC_LOG_LEVEL_DEBUG;  // Default log level
+    ADUVC_LogLevel_t logLevel = ADUVC_LOG_LEVEL_INFO;  // Default log level
+
+    // Writes out the messages of the log macros on its own thread
+    ADUVCLog logger;
 
     // Checks uvc device operations status
     uvc_error_t deviceStatus;
 
     // Pointer to uvc device struct
-    uvc_device_t* pdevice;
+    uvc_device_t* pdevice = NULL;
 
     // Pointer to device context. generated when connecting
-    uvc_context_t* pdeviceContext;
+    uvc_context_t* pdeviceContext = NULL;
 
     // Pointer to device handle.
     // Used for controlling device.
     // Each UVC device can allow for one handle at a time
-    uvc_device_handle_t* pdeviceHandle;
+    uvc_device_handle_t* pdeviceHandle = NULL;
 
     // Device stream controller. used to control streaming from device
     uvc_stream_ctrl_t deviceStreamCtrl;
 
+    // Set while the device streams, so that only the first of several stop requests stops it.
+    // Guarded by the port lock
+    bool streaming = false;
+
     // Pointer to struct containing device info, such as vendor, product id
     uvc_device_descriptor_t* pdeviceInfo;
 
@@ -221,9 +393,112 @@ class ADUVC : ADDriver {
     // flag that sees if shutter is on or off
     int withShutter = 0;
 
+    // Settings of the acquisition pipeline. acqConfig is edited by the port thread with the port
+    // locked, and copied to sharedConfig by updateConfig, which then counts a new version.
+    // Each pipeline thread refreshes its own copy from sharedConfig when the version changes
+    ADUVC_AcqConfig_t acqConfig;
+    ADUVC_AcqConfig_t sharedConfig;
+    epicsMutexId configLock = NULL;
+    int configVersion = 0;
+
+    // ----- State of the frame callback -----
+    ADUVC_AcqConfig_t intakeConfig;
+    int intakeConfigVersion = -1;
+    int intakeAcquisition = -1;
+
+    // Frames received and dropped for lack of a buffer in the current acquisition
+    int framesReceived = 0;
+    int framesDropped = 0;
+
+    // Frames received since the last one considered by the decimation, and the earliest time of
+    // the next published frame
+    int framesSinceDecimated = 0;
+    bool publishScheduled = false;
+    epicsTimeStamp nextPublishTime;
+
+    // ----- State of the convert thread -----
+    ADUVC_AcqConfig_t convertConfig;
+    int convertConfigVersion = -1;
+    int convertAcquisition = -1;
+
+    // Images converted in the current acquisition
+    int imagesConverted = 0;
+
     // Flag for checking if frame size was validated with selected dtype and color mode
     bool validatedFrameSize = false;
 
+    // Threads converting row bands of uncompressed frames
+    ADUVCThreadPool convertPool;
+
+    // Lookup tables built for the selected Y'CbCr to RGB matrix
+    int yuvTablesMatrix = -1;
+    ADUVC_YUVTables_t yuvTables;
+
+    // Scratch frame for conversion kernels that work in two passes
+    uvc_frame_t* pScratchFrame = NULL;
+
+    // Conversion kernel selected for the stream, and the frame format it was selected for
+    const ADUVC_Kernel_t* pKernel = NULL;
+    uvc_frame_format kernelFrameFormat = UVC_FRAME_FORMAT_UNKNOWN;
+
+    // Kernel converting single rows for binned or reoriented frames, NULL if the output cannot be
+    // binned or reoriented
+    const ADUVC_Kernel_t* pRowKernel = NULL;
+
+    // Statistics of each band of rows of the current frame
+    ADUVC_Stats_t statsParts[ADUVC_MAX_CONVERT_THREADS];
+
+    // Row buffers of each band or MJPEG stripe placed in the NDArray
+    ADUVC_PlaceBuffers_t placeBuffers[ADUVC_MAX_PLACE_BUFFERS] = {};
+
+    // ----- State of the publish thread -----
+    ADUVC_AcqConfig_t outputConfig;
+    int outputConfigVersion = -1;
+
+    // NDArrays published, also set by writes to NDArrayCounter
+    int arrayCounter = 0;
+
+    // Size of the last NDArray converted, posted by flushCounters along with the counters above.
+    // Counters are written by their own thread, and read by the counter thread
+    int arraySize = 0;
+    int arraySizeX = 0;
+    int arraySizeY = 0;
+
+    // Thread posting the counters at counterRate, woken early when the rate changes or the
+    // driver shuts down, and by every frame when the rate is 0
+    epicsEventId counterEvent = NULL;
+    epicsEventId counterDone = NULL;
+    bool counterExit = false;
+
+    // Latency of each stage of the pipeline over recent published frames
+    ADUVCLatency latency;
+
+    // Frames converted and published, and size of the MJPEG frames converted, since the driver
+    // started. Rates are published from their difference with lastTotals every monitor period
+    size_t framesDecoded = 0;
+    size_t framesPublished = 0;
+    size_t mjpegFrames = 0;
+    size_t mjpegBytes = 0;
+    ADUVC_RateTotals_t lastTotals;
+
+    // CPU time used by the convert and publish threads since the driver started, in microseconds
+    size_t convertCpuUs = 0;
+    size_t publishCpuUs = 0;
+
+    // Last frames received, published or dropped, and the next driver in the list searched by
+    // ADUVCDumpRecorder
+    ADUVCRecorder recorder;
+    ADUVC* pNextDriver = NULL;
+
+    // Acquisition pipeline. The frame callback copies frames to free buffers and queues them for
+    // the convert thread, which queues NDArrays for the publish thread. Both threads drop items
+    // queued before acquisition was last started or stopped, counted by acquisition
+    epicsMessageQueueId freeFrameQueue = NULL;
+    epicsMessageQueueId convertQueue = NULL;
+    epicsMessageQueueId publishQueue = NULL;
+    epicsEventId pipelineDone = NULL;
+    int acquisition = 0;
+
     // ----------------------------------------
     // UVC Functions - Logging/Reporting
     //-----------------------------------------
@@ -268,12 +543,40 @@ class ADUVC : ADDriver {
     int zoomSteps = 10;
 
     // Functions that start/stop image aquisition
+    uvc_error_t negotiateRegionStream(uvc_frame_format imageFormat, int width, int height,
+                                      int framerate);
     uvc_error_t acquireStart(uvc_frame_format format);
     void acquireStop();
 
     // Function that converts a UVC frame into an NDArray
-    asynStatus uvc2NDArray(uvc_frame_t* frame, NDArray* pArray, NDDataType_t dataType,
-                           NDColorMode_t colorMode, size_t imBytes);
+    asynStatus uvc2NDArray(uvc_frame_t* frame, NDArray* pArray, const ADUVC_Kernel_t* pKernel,
+                           const ADUVC_Geometry_t* pGeometry, size_t imBytes);
+
+    // Function that merges the statistics of a frame and publishes them as PVs and attributes
+    void publishStats(NDArray* pArray, int numParts, const ADUVC_Geometry_t* pGeometry);
+
+    // Function that attaches the sequence, device time stamps, size and timing of a frame to its
+    // NDArray
+    void addFrameAttributes(NDArray* pArray, const ADUVC_FrameTrace_t* pTrace);
+
+    // Function that selects the conversion kernel for the stream, data type and color mode
+    void selectKernel(uvc_frame_format frameFormat, size_t width, size_t height);
+
+    // Function that decides whether a received frame is published or decimated
+    bool decimateFrame();
+
+    // Functions that publish the settings of the pipeline, and refresh a thread's copy of them
+    void updateConfig();
+    bool refreshConfig(ADUVC_AcqConfig_t* pConfig, int* pVersion);
+
+    // Functions that post the pipeline counters from the counter thread, and the latency,
+    // throughput and CPU usage of its stages
+    void flushCounters();
+    void publishLatency();
+    void publishRates(double seconds);
+    void addThreadCpu(size_t* pTotalUs, uint64_t* pLastCpuNs);
+    void counterThread();
+    static void counterThreadC(void* pPvt);
 
     // Function that attempts to fit data type + color mode to frame if size doesn't match
     void checkValidFrameSize(uvc_frame_t* frame);
@@ -288,6 +591,14 @@ class ADUVC : ADDriver {
     // Static wrapper function for callback.
     // Necessary becuase callback in UVC must be static but we want the driver running the callback
     static void newFrameCallbackWrapper(uvc_frame_t* frame, void* ptr);
+
+    // Stages of the acquisition pipeline after the frame callback, and their threads
+    void convertFrame(ADUVC_QueuedFrame_t* pItem);
+    void publishArray(ADUVC_QueuedArray_t* pItem);
+    void convertThread();
+    void publishThread();
+    static void convertThreadC(void* pPvt);
+    static void publishThreadC(void* pPvt);
 };
 
 // Stores number of additional PV parameters are added by the driver
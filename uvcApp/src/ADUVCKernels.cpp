@@ -0,0 +1,1346 @@
+/*
+ * Frame conversion kernels and the kernel table used by the ADUVC driver
+ *
+ * Kernels for packed formats convert the band of rows [firstRow, lastRow). Kernels for MJPEG
+ * decode the whole frame regardless of the band.
+ *
+ * Copyright (c) : 2018-2025 Brookhaven National Laboratory
+ *
+ */
+
+#include "ADUVCKernels.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+//-------------------------------------------------------
+// Color matrices
+//-------------------------------------------------------
+
+/*
+ * Function that fills the Y'CbCr to RGB lookup tables for a color matrix. Limited range matrices
+ * map luma 16-235 and chroma 16-240 onto the full 0-255 range.
+ *
+ * @params[out]: pTables    -> tables to fill
+ * @params[in]:  matrix     -> BT.601 or BT.709, full or limited range
+ * @return: void
+ */
+void ADUVC_buildYUVTables(ADUVC_YUVTables_t* pTables, ADUVC_ColorMatrix_t matrix) {
+    bool bt709 = matrix == ADUVC_ColorMatrixBT709Full || matrix == ADUVC_ColorMatrixBT709Limited;
+    bool limited =
+        matrix == ADUVC_ColorMatrixBT601Limited || matrix == ADUVC_ColorMatrixBT709Limited;
+
+    double kr = bt709 ? 0.2126 : 0.299;
+    double kb = bt709 ? 0.0722 : 0.114;
+    double kg = 1.0 - kr - kb;
+    double yScale = limited ? 255.0 / 219.0 : 1.0;
+    double yOffset = limited ? 16.0 : 0.0;
+    double cScale = limited ? 255.0 / 224.0 : 1.0;
+    const double one = 65536.0;
+
+    for (int i = 0; i < 256; i++) {
+        double c = (i - 128) * cScale;
+        pTables->y[i] = (int32_t) lround((i - yOffset) * yScale * one) + (int32_t) (one / 2);
+        pTables->rV[i] = (int32_t) lround(2.0 * (1.0 - kr) * c * one);
+        pTables->gU[i] = (int32_t) lround(-2.0 * kb * (1.0 - kb) / kg * c * one);
+        pTables->gV[i] = (int32_t) lround(-2.0 * kr * (1.0 - kr) / kg * c * one);
+        pTables->bU[i] = (int32_t) lround(2.0 * (1.0 - kb) * c * one);
+    }
+
+    const double q13 = 8192.0;
+    pTables->yOffset = (int16_t) (yOffset * 64);
+    pTables->yCoef = (int16_t) lround(yScale * q13);
+    pTables->rVCoef = (int16_t) lround(2.0 * (1.0 - kr) * cScale * q13);
+    pTables->gUCoef = (int16_t) lround(-2.0 * kb * (1.0 - kb) / kg * cScale * q13);
+    pTables->gVCoef = (int16_t) lround(-2.0 * kr * (1.0 - kr) / kg * cScale * q13);
+    pTables->bUCoef = (int16_t) lround(2.0 * (1.0 - kb) * cScale * q13);
+}
+
+//-------------------------------------------------------
+// Non-template kernels
+//-------------------------------------------------------
+
+/*
+ * Wraps the row band of the input frame and NDArray buffer as uvc frames, so that libuvc
+ * conversions can write straight into the NDArray. The input keeps the frame's step, which the
+ * wrapped conversions honour, and ends where the frame does, as its last row may be unpadded.
+ */
+static void wrapBand(ADUVC_KernelArgs_t* args, size_t outBytesPerPixel, uvc_frame_t* pIn,
+                     uvc_frame_t* pOut) {
+    size_t rows = args->lastRow - args->firstRow;
+    size_t bandOffset = args->firstRow * args->inStep;
+
+    memset(pIn, 0, sizeof(*pIn));
+    pIn->frame_format = args->frame->frame_format;
+    pIn->width = args->width;
+    pIn->height = rows;
+    pIn->step = args->inStep;
+    pIn->data = (uint8_t*) args->frame->data + bandOffset;
+    pIn->data_bytes = rows * args->inStep;
+    if (bandOffset + pIn->data_bytes > args->frame->data_bytes)
+        pIn->data_bytes = args->frame->data_bytes - bandOffset;
+
+    memset(pOut, 0, sizeof(*pOut));
+    size_t outRow = args->firstRow - args->outFirstRow;
+    pOut->data = (uint8_t*) args->pOut + outRow * args->width * outBytesPerPixel;
+    pOut->data_bytes = rows * args->width * outBytesPerPixel;
+    pOut->library_owns_data = 0;
+}
+
+/*
+ * Wraps the whole NDArray buffer as a uvc frame. library_owns_data = 0 makes libuvc fail rather
+ * than realloc if the buffer is too small.
+ */
+static void wrapArray(ADUVC_KernelArgs_t* args, uvc_frame_t* pOut) {
+    memset(pOut, 0, sizeof(*pOut));
+    pOut->data = args->pOut;
+    pOut->data_bytes = args->outBytes;
+    pOut->library_owns_data = 0;
+}
+
+static uvc_error_t yuyvToMono(ADUVC_KernelArgs_t* args) {
+    uvc_frame_t in, out;
+    wrapBand(args, 1, &in, &out);
+    return uvc_yuyv2y(&in, &out);
+}
+
+static uvc_error_t uyvyToMono(ADUVC_KernelArgs_t* args) {
+    uvc_frame_t in, out;
+    wrapBand(args, 1, &in, &out);
+    return uvc_uyvy2y(&in, &out);
+}
+
+// areaDetector stores YUV422 as packed UYVY
+static uvc_error_t yuyvToYUV422(ADUVC_KernelArgs_t* args) {
+    uvc_frame_t in, out;
+    wrapBand(args, 2, &in, &out);
+    return uvc_yuyv2uyvy(&in, &out);
+}
+
+static uvc_error_t mjpegToMono(ADUVC_KernelArgs_t* args) {
+    uvc_frame_t out;
+    wrapArray(args, &out);
+    return uvc_mjpeg2gray_threaded(args->frame, &out, args->decodeThreads);
+}
+
+static uvc_error_t mjpegToRGB1(ADUVC_KernelArgs_t* args) {
+    uvc_frame_t out;
+    wrapArray(args, &out);
+    return uvc_mjpeg2rgb_threaded(args->frame, &out, args->decodeThreads);
+}
+
+static uvc_error_t mjpegToYUV422(ADUVC_KernelArgs_t* args) {
+    uvc_frame_t out;
+    wrapArray(args, &out);
+    return uvc_mjpeg2uyvy_threaded(args->frame, &out, args->decodeThreads);
+}
+
+/*
+ * Shifts little endian 16 bit greyscale samples right by bitShift and keeps the low Bits bits, so
+ * that left justified samples and garbage in unused high bits both end up as plain values.
+ */
+template <int Bits>
+static uvc_error_t shiftGray16(ADUVC_KernelArgs_t* args) {
+    const uint16_t mask = (uint16_t) ((1u << Bits) - 1);
+    const int shift = args->bitShift;
+    if (Bits == 16 && shift == 0) return ADUVC_copyRows<2>(args);
+
+    for (size_t y = args->firstRow; y < args->lastRow; y++) {
+        const uint8_t* pIn = (const uint8_t*) args->frame->data + y * args->inStep;
+        uint16_t* pOut = (uint16_t*) args->pOut + (y - args->outFirstRow) * args->width;
+        size_t x = 0;
+#if defined(__SSE2__)
+        const __m128i vMask = _mm_set1_epi16((short) mask);
+        const __m128i vShift = _mm_cvtsi32_si128(shift);
+        for (; x + 8 <= args->width; x += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (pIn + 2 * x));
+            v = _mm_and_si128(_mm_srl_epi16(v, vShift), vMask);
+            _mm_storeu_si128((__m128i*) (pOut + x), v);
+        }
+#elif defined(__ARM_NEON)
+        const uint16x8_t vMask = vdupq_n_u16(mask);
+        const int16x8_t vShift = vdupq_n_s16((int16_t) -shift);
+        for (; x + 8 <= args->width; x += 8) {
+            uint16x8_t v = vreinterpretq_u16_u8(vld1q_u8(pIn + 2 * x));
+            vst1q_u16(pOut + x, vandq_u16(vshlq_u16(v, vShift), vMask));
+        }
+#endif
+        for (; x < args->width; x++)
+            pOut[x] = (uint16_t) (((pIn[2 * x] | (pIn[2 * x + 1] << 8)) >> shift) & mask);
+    }
+    return UVC_SUCCESS;
+}
+
+/*
+ * Unpacks MIPI CSI-2 RAW10 rows. Each group of 4 pixels stores their high 8 bits in 4 bytes,
+ * followed by one byte holding the low 2 bits of each pixel.
+ */
+static uvc_error_t unpackY10P(ADUVC_KernelArgs_t* args) {
+    for (size_t y = args->firstRow; y < args->lastRow; y++) {
+        const uint8_t* pIn = (const uint8_t*) args->frame->data + y * args->inStep;
+        uint16_t* pOut = (uint16_t*) args->pOut + (y - args->outFirstRow) * args->width;
+        size_t x = 0;
+        for (; x + 4 <= args->width; x += 4, pIn += 5) {
+            unsigned low = pIn[4];
+            pOut[x] = (uint16_t) ((pIn[0] << 2) | (low & 0x3));
+            pOut[x + 1] = (uint16_t) ((pIn[1] << 2) | ((low >> 2) & 0x3));
+            pOut[x + 2] = (uint16_t) ((pIn[2] << 2) | ((low >> 4) & 0x3));
+            pOut[x + 3] = (uint16_t) ((pIn[3] << 2) | (low >> 6));
+        }
+        // rows are padded to a whole group, so the low bits byte is there for a partial group
+        for (int i = 0; x < args->width; x++, i++)
+            pOut[x] = (uint16_t) ((pIn[i] << 2) | ((pIn[4] >> (2 * i)) & 0x3));
+    }
+    return UVC_SUCCESS;
+}
+
+/*
+ * Unpacks MIPI CSI-2 RAW12 rows. Each pair of pixels stores their high 8 bits in 2 bytes,
+ * followed by one byte holding the low 4 bits of both.
+ */
+static uvc_error_t unpackY12P(ADUVC_KernelArgs_t* args) {
+    for (size_t y = args->firstRow; y < args->lastRow; y++) {
+        const uint8_t* pIn = (const uint8_t*) args->frame->data + y * args->inStep;
+        uint16_t* pOut = (uint16_t*) args->pOut + (y - args->outFirstRow) * args->width;
+        size_t x = 0;
+        for (; x + 2 <= args->width; x += 2, pIn += 3) {
+            pOut[x] = (uint16_t) ((pIn[0] << 4) | (pIn[2] & 0xf));
+            pOut[x + 1] = (uint16_t) ((pIn[1] << 4) | (pIn[2] >> 4));
+        }
+        if (x < args->width) pOut[x] = (uint16_t) ((pIn[0] << 4) | (pIn[2] & 0xf));
+    }
+    return UVC_SUCCESS;
+}
+
+static inline uint8_t avg2(unsigned a, unsigned b) { return (uint8_t) ((a + b + 1) >> 1); }
+
+/*
+ * Bilinear interpolation of one pixel of a Bayer row. c1 is the colour sampled on this row, red or
+ * blue, and c2 the one sampled on the rows above and below. Averages of four samples are taken as
+ * two rounded pairwise averages, exactly as in the SIMD path. Edges are mirrored, which keeps the
+ * mosaic phase.
+ */
+static inline void demosaicPixel(const uint8_t* pUp, const uint8_t* pCur, const uint8_t* pDown,
+                                 size_t x, size_t width, bool colorSite, uint8_t* pC1, uint8_t* pG,
+                                 uint8_t* pC2) {
+    size_t l = x > 0 ? x - 1 : 1;
+    size_t r = x + 1 < width ? x + 1 : x - 1;
+    uint8_t horizontal = avg2(pCur[l], pCur[r]);
+    uint8_t vertical = avg2(pUp[x], pDown[x]);
+
+    if (colorSite) {
+        *pC1 = pCur[x];
+        *pG = avg2(horizontal, vertical);
+        *pC2 = avg2(avg2(pUp[l], pUp[r]), avg2(pDown[l], pDown[r]));
+    } else {
+        *pC1 = horizontal;
+        *pG = pCur[x];
+        *pC2 = vertical;
+    }
+}
+
+/*
+ * Demosaics 8 bit Bayer frames to RGB with bilinear interpolation. The interior of each row is
+ * interpolated 16 pixels at a time, the first and last pixels use mirrored neighbours. Rows above
+ * and below the band are only read, so bands can be converted in parallel.
+ */
+template <NDColorMode_t ColorMode>
+static uvc_error_t bayerToRGB(ADUVC_KernelArgs_t* args) {
+    const size_t s = ADUVC_RGBLayout<ColorMode>::pixelStride;
+    const size_t width = args->width;
+    const uint8_t* pIn = (const uint8_t*) args->frame->data;
+
+    NDBayerPattern_t pattern;
+    if (!ADUVC_getBayerPattern(args->frame->frame_format, args->by8Pattern, &pattern))
+        return UVC_ERROR_NOT_SUPPORTED;
+    if (width < 2 || args->height < 2) return UVC_ERROR_INVALID_PARAM;
+
+    // position of the red sample in the 2x2 tile
+    size_t redX = (pattern == NDBayerGRBG || pattern == NDBayerBGGR) ? 1 : 0;
+    size_t redY = (pattern == NDBayerGBRG || pattern == NDBayerBGGR) ? 1 : 0;
+
+    for (size_t y = args->firstRow; y < args->lastRow; y++) {
+        const uint8_t* pCur = pIn + y * args->inStep;
+        const uint8_t* pUp = pIn + (y > 0 ? y - 1 : 1) * args->inStep;
+        const uint8_t* pDown = pIn + (y + 1 < args->height ? y + 1 : y - 1) * args->inStep;
+        uint8_t *pR, *pG, *pB;
+        ADUVC_RGBLayout<ColorMode>::rows(args, y - args->outFirstRow, &pR, &pG, &pB);
+
+        // red rows sample red and green, blue rows sample green and blue
+        bool redRow = (y & 1) == redY;
+        uint8_t* pC1 = redRow ? pR : pB;
+        uint8_t* pC2 = redRow ? pB : pR;
+        size_t colorParity = redRow ? redX : 1 - redX;
+
+        demosaicPixel(pUp, pCur, pDown, 0, width, colorParity == 0, pC1, pG, pC2);
+        size_t x = 1;
+#if defined(__SSE2__)
+        // vectors start on odd pixels, so their even bytes hold odd pixels
+        const __m128i evenBytes = _mm_set1_epi16(0x00ff);
+        const __m128i colorMask =
+            colorParity == 1 ? evenBytes : _mm_andnot_si128(evenBytes, _mm_set1_epi8(-1));
+        for (; x + 17 <= width; x += 16) {
+            __m128i c = _mm_loadu_si128((const __m128i*) (pCur + x));
+            __m128i h = _mm_avg_epu8(_mm_loadu_si128((const __m128i*) (pCur + x - 1)),
+                                     _mm_loadu_si128((const __m128i*) (pCur + x + 1)));
+            __m128i v = _mm_avg_epu8(_mm_loadu_si128((const __m128i*) (pUp + x)),
+                                     _mm_loadu_si128((const __m128i*) (pDown + x)));
+            __m128i dUp = _mm_avg_epu8(_mm_loadu_si128((const __m128i*) (pUp + x - 1)),
+                                       _mm_loadu_si128((const __m128i*) (pUp + x + 1)));
+            __m128i dDown = _mm_avg_epu8(_mm_loadu_si128((const __m128i*) (pDown + x - 1)),
+                                         _mm_loadu_si128((const __m128i*) (pDown + x + 1)));
+            __m128i d = _mm_avg_epu8(dUp, dDown);
+
+            __m128i c1 = _mm_or_si128(_mm_and_si128(colorMask, c), _mm_andnot_si128(colorMask, h));
+            __m128i g = _mm_or_si128(_mm_and_si128(colorMask, _mm_avg_epu8(h, v)),
+                                     _mm_andnot_si128(colorMask, c));
+            __m128i c2 = _mm_or_si128(_mm_and_si128(colorMask, d), _mm_andnot_si128(colorMask, v));
+
+            if (s == 1) {
+                _mm_storeu_si128((__m128i*) (pC1 + x), c1);
+                _mm_storeu_si128((__m128i*) (pG + x), g);
+                _mm_storeu_si128((__m128i*) (pC2 + x), c2);
+            } else {
+                uint8_t tmp[3][16];
+                _mm_storeu_si128((__m128i*) tmp[0], c1);
+                _mm_storeu_si128((__m128i*) tmp[1], g);
+                _mm_storeu_si128((__m128i*) tmp[2], c2);
+                for (size_t i = 0; i < 16; i++) {
+                    pC1[(x + i) * s] = tmp[0][i];
+                    pG[(x + i) * s] = tmp[1][i];
+                    pC2[(x + i) * s] = tmp[2][i];
+                }
+            }
+        }
+#elif defined(__ARM_NEON)
+        static const uint8_t evenBytes[16] = {0xff, 0, 0xff, 0, 0xff, 0, 0xff, 0,
+                                              0xff, 0, 0xff, 0, 0xff, 0, 0xff, 0};
+        const uint8x16_t colorMask =
+            colorParity == 1 ? vld1q_u8(evenBytes) : vmvnq_u8(vld1q_u8(evenBytes));
+        for (; x + 17 <= width; x += 16) {
+            uint8x16_t c = vld1q_u8(pCur + x);
+            uint8x16_t h = vrhaddq_u8(vld1q_u8(pCur + x - 1), vld1q_u8(pCur + x + 1));
+            uint8x16_t v = vrhaddq_u8(vld1q_u8(pUp + x), vld1q_u8(pDown + x));
+            uint8x16_t d = vrhaddq_u8(vrhaddq_u8(vld1q_u8(pUp + x - 1), vld1q_u8(pUp + x + 1)),
+                                      vrhaddq_u8(vld1q_u8(pDown + x - 1), vld1q_u8(pDown + x + 1)));
+
+            uint8x16_t c1 = vbslq_u8(colorMask, c, h);
+            uint8x16_t g = vbslq_u8(colorMask, vrhaddq_u8(h, v), c);
+            uint8x16_t c2 = vbslq_u8(colorMask, d, v);
+
+            if (s == 1) {
+                vst1q_u8(pC1 + x, c1);
+                vst1q_u8(pG + x, g);
+                vst1q_u8(pC2 + x, c2);
+            } else {
+                uint8x16x3_t rgb;
+                rgb.val[0] = redRow ? c1 : c2;
+                rgb.val[1] = g;
+                rgb.val[2] = redRow ? c2 : c1;
+                vst3q_u8(pR + x * s, rgb);
+            }
+        }
+#endif
+        for (; x < width; x++)
+            demosaicPixel(pUp, pCur, pDown, x, width, (x & 1) == colorParity, pC1 + x * s,
+                          pG + x * s, pC2 + x * s);
+    }
+    return UVC_SUCCESS;
+}
+
+//-------------------------------------------------------
+// Semi-planar 4:2:0 (NV12 and P010)
+//-------------------------------------------------------
+
+/*
+ * Semi-planar frames hold a full resolution luma plane followed by a half resolution plane of
+ * interleaved Cb/Cr pairs, both with the frame step. Samples are scaled by 64 before applying the
+ * Q13 coefficients, which gives results with 3 fractional bits; 8 bit NV12 samples are shifted
+ * left by 6 and the left justified 10 bit P010 samples right by 2.
+ */
+static inline int mulQ13(int sample, int coef) { return (sample * coef) >> 16; }
+
+static inline void yuv420Pixel(int ys, int us, int vs, const ADUVC_YUVTables_t* t, uint8_t* pR,
+                               uint8_t* pG, uint8_t* pB) {
+    int y = mulQ13(ys - t->yOffset, t->yCoef) + 4;
+    *pR = ADUVC_saturate((y + mulQ13(vs, t->rVCoef)) >> 3);
+    *pG = ADUVC_saturate((y + mulQ13(us, t->gUCoef) + mulQ13(vs, t->gVCoef)) >> 3);
+    *pB = ADUVC_saturate((y + mulQ13(us, t->bUCoef)) >> 3);
+}
+
+#if defined(__SSE2__)
+// Same arithmetic as yuv420Pixel on 8 pixels, returning 16 bit results before saturation
+static inline void yuv420Pixels(__m128i ys, __m128i us, __m128i vs, const ADUVC_YUVTables_t* t,
+                                __m128i* pR, __m128i* pG, __m128i* pB) {
+    __m128i y = _mm_mulhi_epi16(_mm_sub_epi16(ys, _mm_set1_epi16(t->yOffset)),
+                                _mm_set1_epi16(t->yCoef));
+    y = _mm_add_epi16(y, _mm_set1_epi16(4));
+    __m128i gu = _mm_mulhi_epi16(us, _mm_set1_epi16(t->gUCoef));
+    __m128i gv = _mm_mulhi_epi16(vs, _mm_set1_epi16(t->gVCoef));
+    *pR = _mm_srai_epi16(_mm_add_epi16(y, _mm_mulhi_epi16(vs, _mm_set1_epi16(t->rVCoef))), 3);
+    *pG = _mm_srai_epi16(_mm_add_epi16(y, _mm_add_epi16(gu, gv)), 3);
+    *pB = _mm_srai_epi16(_mm_add_epi16(y, _mm_mulhi_epi16(us, _mm_set1_epi16(t->bUCoef))), 3);
+}
+
+// Splits 4 scaled Cb/Cr pairs into Cb and Cr for 8 pixels, centred on zero
+static inline void yuv420Chroma(__m128i uv, __m128i* pU, __m128i* pV) {
+    __m128i u = _mm_and_si128(uv, _mm_set1_epi32(0xffff));
+    __m128i v = _mm_srli_epi32(uv, 16);
+    *pU = _mm_sub_epi16(_mm_or_si128(u, _mm_slli_epi32(u, 16)), _mm_set1_epi16(128 << 6));
+    *pV = _mm_sub_epi16(_mm_or_si128(v, _mm_slli_epi32(v, 16)), _mm_set1_epi16(128 << 6));
+}
+#elif defined(__ARM_NEON)
+static inline int16x8_t mulhi(int16x8_t a, int16_t b) {
+    int32x4_t lo = vmull_n_s16(vget_low_s16(a), b);
+    int32x4_t hi = vmull_n_s16(vget_high_s16(a), b);
+    return vcombine_s16(vshrn_n_s32(lo, 16), vshrn_n_s32(hi, 16));
+}
+
+static inline void yuv420Pixels(int16x8_t ys, int16x8_t us, int16x8_t vs,
+                                const ADUVC_YUVTables_t* t, uint8x8_t* pR, uint8x8_t* pG,
+                                uint8x8_t* pB) {
+    int16x8_t y = vaddq_s16(mulhi(vsubq_s16(ys, vdupq_n_s16(t->yOffset)), t->yCoef),
+                            vdupq_n_s16(4));
+    int16x8_t g = vaddq_s16(mulhi(us, t->gUCoef), mulhi(vs, t->gVCoef));
+    *pR = vqmovun_s16(vshrq_n_s16(vaddq_s16(y, mulhi(vs, t->rVCoef)), 3));
+    *pG = vqmovun_s16(vshrq_n_s16(vaddq_s16(y, g), 3));
+    *pB = vqmovun_s16(vshrq_n_s16(vaddq_s16(y, mulhi(us, t->bUCoef)), 3));
+}
+#endif
+
+/*
+ * Converts NV12 or P010 frames to 8 bit RGB with the selected color matrix, 16 pixels at a time.
+ * Each 2x2 block of pixels shares one chroma pair.
+ */
+template <bool P010, NDColorMode_t ColorMode>
+static uvc_error_t yuv420ToRGB(ADUVC_KernelArgs_t* args) {
+    const size_t s = ADUVC_RGBLayout<ColorMode>::pixelStride;
+    const size_t width = args->width;
+    const ADUVC_YUVTables_t* t = args->pYUVTables;
+    const uint8_t* pIn = (const uint8_t*) args->frame->data;
+    const uint8_t* pChroma = pIn + args->inStep * args->height;
+
+    // the last chroma row only needs to hold the converted columns
+    const size_t lastInputRow = args->height + (args->height + 1) / 2 - 1;
+    if (width & 1) return UVC_ERROR_INVALID_PARAM;
+    if (args->frame->data_bytes < args->inStep * lastInputRow + width * (P010 ? 2 : 1))
+        return UVC_ERROR_NO_MEM;
+
+    for (size_t y = args->firstRow; y < args->lastRow; y++) {
+        const uint8_t* pY = pIn + y * args->inStep;
+        const uint8_t* pUV = pChroma + (y / 2) * args->inStep;
+        uint8_t *pR, *pG, *pB;
+        ADUVC_RGBLayout<ColorMode>::rows(args, y - args->outFirstRow, &pR, &pG, &pB);
+
+        size_t x = 0;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        for (; x + 16 <= width; x += 16) {
+            __m128i ys[2], uvs[2];
+            if (P010) {
+                for (int h = 0; h < 2; h++) {
+                    ys[h] = _mm_srli_epi16(_mm_loadu_si128((const __m128i*) (pY + 2 * x) + h), 2);
+                    uvs[h] = _mm_srli_epi16(_mm_loadu_si128((const __m128i*) (pUV + 2 * x) + h), 2);
+                }
+            } else {
+                __m128i y8 = _mm_loadu_si128((const __m128i*) (pY + x));
+                __m128i uv8 = _mm_loadu_si128((const __m128i*) (pUV + x));
+                ys[0] = _mm_slli_epi16(_mm_unpacklo_epi8(y8, zero), 6);
+                ys[1] = _mm_slli_epi16(_mm_unpackhi_epi8(y8, zero), 6);
+                uvs[0] = _mm_slli_epi16(_mm_unpacklo_epi8(uv8, zero), 6);
+                uvs[1] = _mm_slli_epi16(_mm_unpackhi_epi8(uv8, zero), 6);
+            }
+
+            __m128i r[2], g[2], b[2];
+            for (int h = 0; h < 2; h++) {
+                __m128i us, vs;
+                yuv420Chroma(uvs[h], &us, &vs);
+                yuv420Pixels(ys[h], us, vs, t, &r[h], &g[h], &b[h]);
+            }
+            __m128i r8 = _mm_packus_epi16(r[0], r[1]);
+            __m128i g8 = _mm_packus_epi16(g[0], g[1]);
+            __m128i b8 = _mm_packus_epi16(b[0], b[1]);
+
+            if (s == 1) {
+                _mm_storeu_si128((__m128i*) (pR + x), r8);
+                _mm_storeu_si128((__m128i*) (pG + x), g8);
+                _mm_storeu_si128((__m128i*) (pB + x), b8);
+            } else {
+                uint8_t tmp[3][16];
+                _mm_storeu_si128((__m128i*) tmp[0], r8);
+                _mm_storeu_si128((__m128i*) tmp[1], g8);
+                _mm_storeu_si128((__m128i*) tmp[2], b8);
+                for (size_t i = 0; i < 16; i++) {
+                    pR[(x + i) * s] = tmp[0][i];
+                    pG[(x + i) * s] = tmp[1][i];
+                    pB[(x + i) * s] = tmp[2][i];
+                }
+            }
+        }
+#elif defined(__ARM_NEON)
+        for (; x + 16 <= width; x += 16) {
+            int16x8_t ys[2], us[2], vs[2];
+            if (P010) {
+                uint16x8x2_t uv = vld2q_u16((const uint16_t*) (pUV + 2 * x));
+                uint16x8x2_t u = vzipq_u16(uv.val[0], uv.val[0]);
+                uint16x8x2_t v = vzipq_u16(uv.val[1], uv.val[1]);
+                for (int h = 0; h < 2; h++) {
+                    uint16x8_t y16 = vld1q_u16((const uint16_t*) (pY + 2 * x) + 8 * h);
+                    ys[h] = vreinterpretq_s16_u16(vshrq_n_u16(y16, 2));
+                    us[h] = vreinterpretq_s16_u16(vshrq_n_u16(u.val[h], 2));
+                    vs[h] = vreinterpretq_s16_u16(vshrq_n_u16(v.val[h], 2));
+                }
+            } else {
+                uint8x16_t y8 = vld1q_u8(pY + x);
+                uint8x8x2_t uv = vld2_u8(pUV + x);
+                uint8x8x2_t u = vzip_u8(uv.val[0], uv.val[0]);
+                uint8x8x2_t v = vzip_u8(uv.val[1], uv.val[1]);
+                ys[0] = vreinterpretq_s16_u16(vshll_n_u8(vget_low_u8(y8), 6));
+                ys[1] = vreinterpretq_s16_u16(vshll_n_u8(vget_high_u8(y8), 6));
+                for (int h = 0; h < 2; h++) {
+                    us[h] = vreinterpretq_s16_u16(vshll_n_u8(u.val[h], 6));
+                    vs[h] = vreinterpretq_s16_u16(vshll_n_u8(v.val[h], 6));
+                }
+            }
+
+            uint8x16x3_t rgb;
+            uint8x8_t r[2], g[2], b[2];
+            for (int h = 0; h < 2; h++) {
+                int16x8_t u = vsubq_s16(us[h], vdupq_n_s16(128 << 6));
+                int16x8_t v = vsubq_s16(vs[h], vdupq_n_s16(128 << 6));
+                yuv420Pixels(ys[h], u, v, t, &r[h], &g[h], &b[h]);
+            }
+            rgb.val[0] = vcombine_u8(r[0], r[1]);
+            rgb.val[1] = vcombine_u8(g[0], g[1]);
+            rgb.val[2] = vcombine_u8(b[0], b[1]);
+
+            if (s == 1) {
+                vst1q_u8(pR + x, rgb.val[0]);
+                vst1q_u8(pG + x, rgb.val[1]);
+                vst1q_u8(pB + x, rgb.val[2]);
+            } else {
+                vst3q_u8(pR + x * s, rgb);
+            }
+        }
+#endif
+        for (; x < width; x++) {
+            size_t c = x & ~(size_t) 1;
+            int ys, us, vs;
+            if (P010) {
+                const uint16_t* pY16 = (const uint16_t*) pY;
+                const uint16_t* pUV16 = (const uint16_t*) pUV;
+                ys = pY16[x] >> 2;
+                us = (pUV16[c] >> 2) - (128 << 6);
+                vs = (pUV16[c + 1] >> 2) - (128 << 6);
+            } else {
+                ys = pY[x] << 6;
+                us = (pUV[c] << 6) - (128 << 6);
+                vs = (pUV[c + 1] << 6) - (128 << 6);
+            }
+            yuv420Pixel(ys, us, vs, t, pR + x * s, pG + x * s, pB + x * s);
+        }
+    }
+    return UVC_SUCCESS;
+}
+
+/*
+ * Fallback for Mono output from formats without a dedicated kernel: the frame is copied as is if
+ * its size matches the NDArray exactly.
+ */
+static uvc_error_t rawCopy(ADUVC_KernelArgs_t* args) {
+    if (args->frame->data_bytes != args->outBytes) return UVC_ERROR_NO_MEM;
+    memcpy(args->pOut, args->frame->data, args->outBytes);
+    return UVC_SUCCESS;
+}
+
+//-------------------------------------------------------
+// Kernel table
+//-------------------------------------------------------
+
+// Int8/UInt8 and Int16/UInt16 share a kernel, as the conversion only moves bits
+#define KERNEL_8BIT(format, colorMode, inBitsPerPixel, func)              \
+    {format, NDUInt8, colorMode, inBitsPerPixel, func, #format " -> " #func}, \
+        {format, NDInt8, colorMode, inBitsPerPixel, func, #format " -> " #func}
+
+#define KERNEL_16BIT(format, colorMode, inBitsPerPixel, func)              \
+    {format, NDUInt16, colorMode, inBitsPerPixel, func, #format " -> " #func}, \
+        {format, NDInt16, colorMode, inBitsPerPixel, func, #format " -> " #func}
+
+// Bayer frames are passed through as they are for Mono and Bayer, or demosaiced for RGB
+#define BAYER_KERNELS(format)                                                    \
+    KERNEL_8BIT(format, NDColorModeMono, 8, ADUVC_copyRows<1>),                  \
+        KERNEL_8BIT(format, NDColorModeBayer, 8, ADUVC_copyRows<1>),             \
+        KERNEL_8BIT(format, NDColorModeRGB1, 8, bayerToRGB<NDColorModeRGB1>),    \
+        KERNEL_8BIT(format, NDColorModeRGB2, 8, bayerToRGB<NDColorModeRGB2>),    \
+        KERNEL_8BIT(format, NDColorModeRGB3, 8, bayerToRGB<NDColorModeRGB3>)
+
+static const ADUVC_Kernel_t kernelTable[] = {
+    KERNEL_8BIT(UVC_FRAME_FORMAT_GRAY8, NDColorModeMono, 8, ADUVC_copyRows<1>),
+    KERNEL_16BIT(UVC_FRAME_FORMAT_GRAY16, NDColorModeMono, 16, shiftGray16<16>),
+    KERNEL_16BIT(UVC_FRAME_FORMAT_Y10, NDColorModeMono, 16, shiftGray16<10>),
+    KERNEL_16BIT(UVC_FRAME_FORMAT_Y12, NDColorModeMono, 16, shiftGray16<12>),
+    KERNEL_16BIT(UVC_FRAME_FORMAT_Y10P, NDColorModeMono, 10, unpackY10P),
+    KERNEL_16BIT(UVC_FRAME_FORMAT_Y12P, NDColorModeMono, 12, unpackY12P),
+
+    KERNEL_8BIT(UVC_FRAME_FORMAT_YUYV, NDColorModeMono, 16, yuyvToMono),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_YUYV, NDColorModeRGB1, 16,
+                (ADUVC_yuv422ToRGB<ADUVC_YUYVLayout, NDColorModeRGB1>)),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_YUYV, NDColorModeRGB2, 16,
+                (ADUVC_yuv422ToRGB<ADUVC_YUYVLayout, NDColorModeRGB2>)),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_YUYV, NDColorModeRGB3, 16,
+                (ADUVC_yuv422ToRGB<ADUVC_YUYVLayout, NDColorModeRGB3>)),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_YUYV, NDColorModeYUV422, 16, yuyvToYUV422),
+
+    KERNEL_8BIT(UVC_FRAME_FORMAT_UYVY, NDColorModeMono, 16, uyvyToMono),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_UYVY, NDColorModeRGB1, 16,
+                (ADUVC_yuv422ToRGB<ADUVC_UYVYLayout, NDColorModeRGB1>)),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_UYVY, NDColorModeRGB2, 16,
+                (ADUVC_yuv422ToRGB<ADUVC_UYVYLayout, NDColorModeRGB2>)),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_UYVY, NDColorModeRGB3, 16,
+                (ADUVC_yuv422ToRGB<ADUVC_UYVYLayout, NDColorModeRGB3>)),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_UYVY, NDColorModeYUV422, 16, ADUVC_copyRows<2>),
+
+    KERNEL_8BIT(UVC_FRAME_FORMAT_RGB, NDColorModeRGB1, 24, ADUVC_copyRows<3>),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_RGB, NDColorModeRGB2, 24,
+                (ADUVC_rgbToRGB<false, NDColorModeRGB2>)),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_RGB, NDColorModeRGB3, 24,
+                (ADUVC_rgbToRGB<false, NDColorModeRGB3>)),
+
+    KERNEL_8BIT(UVC_FRAME_FORMAT_BGR, NDColorModeRGB1, 24,
+                (ADUVC_rgbToRGB<true, NDColorModeRGB1>)),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_BGR, NDColorModeRGB2, 24,
+                (ADUVC_rgbToRGB<true, NDColorModeRGB2>)),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_BGR, NDColorModeRGB3, 24,
+                (ADUVC_rgbToRGB<true, NDColorModeRGB3>)),
+
+    BAYER_KERNELS(UVC_FRAME_FORMAT_BY8),
+    BAYER_KERNELS(UVC_FRAME_FORMAT_BA81),
+    BAYER_KERNELS(UVC_FRAME_FORMAT_SGRBG8),
+    BAYER_KERNELS(UVC_FRAME_FORMAT_SGBRG8),
+    BAYER_KERNELS(UVC_FRAME_FORMAT_SRGGB8),
+    BAYER_KERNELS(UVC_FRAME_FORMAT_SBGGR8),
+
+    // the luma plane of semi-planar frames is copied as is for Mono
+    KERNEL_8BIT(UVC_FRAME_FORMAT_NV12, NDColorModeMono, 8, ADUVC_copyRows<1>),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_NV12, NDColorModeRGB1, 8,
+                (yuv420ToRGB<false, NDColorModeRGB1>)),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_NV12, NDColorModeRGB2, 8,
+                (yuv420ToRGB<false, NDColorModeRGB2>)),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_NV12, NDColorModeRGB3, 8,
+                (yuv420ToRGB<false, NDColorModeRGB3>)),
+
+    KERNEL_16BIT(UVC_FRAME_FORMAT_P010, NDColorModeMono, 16, shiftGray16<16>),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_P010, NDColorModeRGB1, 16,
+                (yuv420ToRGB<true, NDColorModeRGB1>)),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_P010, NDColorModeRGB2, 16,
+                (yuv420ToRGB<true, NDColorModeRGB2>)),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_P010, NDColorModeRGB3, 16,
+                (yuv420ToRGB<true, NDColorModeRGB3>)),
+
+    KERNEL_8BIT(UVC_FRAME_FORMAT_MJPEG, NDColorModeMono, 0, mjpegToMono),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_MJPEG, NDColorModeRGB1, 0, mjpegToRGB1),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_MJPEG, NDColorModeRGB2, 0,
+                ADUVC_mjpegToPlanarRGB<NDColorModeRGB2>),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_MJPEG, NDColorModeRGB3, 0,
+                ADUVC_mjpegToPlanarRGB<NDColorModeRGB3>),
+    KERNEL_8BIT(UVC_FRAME_FORMAT_MJPEG, NDColorModeYUV422, 0, mjpegToYUV422),
+};
+
+static const ADUVC_Kernel_t rawCopyKernels[] = {
+    KERNEL_8BIT(UVC_FRAME_FORMAT_ANY, NDColorModeMono, 0, rawCopy),
+    KERNEL_16BIT(UVC_FRAME_FORMAT_ANY, NDColorModeMono, 0, rawCopy),
+};
+
+/*
+ * Function that looks up the conversion kernel for a frame format, data type and color mode.
+ * Formats without any entry in the table can still be copied as is to a Mono NDArray.
+ *
+ * @params[in]: frameFormat -> concrete format of the frames received from the camera
+ * @params[in]: dataType    -> NDArray data type
+ * @params[in]: colorMode   -> NDArray color mode
+ * @return: pointer to the table entry, or NULL if the combination is not supported
+ */
+const ADUVC_Kernel_t* ADUVC_findKernel(uvc_frame_format frameFormat, NDDataType_t dataType,
+                                       NDColorMode_t colorMode) {
+    bool knownFormat = false;
+    for (size_t i = 0; i < sizeof(kernelTable) / sizeof(kernelTable[0]); i++) {
+        const ADUVC_Kernel_t* pKernel = &kernelTable[i];
+        if (pKernel->frameFormat != frameFormat) continue;
+        knownFormat = true;
+        if (pKernel->dataType == dataType && pKernel->colorMode == colorMode) return pKernel;
+    }
+    if (knownFormat) return NULL;
+
+    for (size_t i = 0; i < sizeof(rawCopyKernels) / sizeof(rawCopyKernels[0]); i++) {
+        const ADUVC_Kernel_t* pKernel = &rawCopyKernels[i];
+        if (pKernel->dataType == dataType && pKernel->colorMode == colorMode) return pKernel;
+    }
+
+    return NULL;
+}
+
+/*
+ * Function that gets the output that keeps the full depth and color of a frame format. Used to
+ * pick a data type and color mode when the selected ones cannot be produced from the format.
+ *
+ * @params[in]:  frameFormat -> concrete format of the frames received from the camera
+ * @params[out]: pDataType   -> NDArray data type
+ * @params[out]: pColorMode  -> NDArray color mode
+ * @return: true if the format was identified, false otherwise
+ */
+bool ADUVC_getNativeOutput(uvc_frame_format frameFormat, NDDataType_t* pDataType,
+                           NDColorMode_t* pColorMode) {
+    switch (frameFormat) {
+        case UVC_FRAME_FORMAT_GRAY8:
+            *pDataType = NDUInt8;
+            *pColorMode = NDColorModeMono;
+            return true;
+        case UVC_FRAME_FORMAT_GRAY16:
+        case UVC_FRAME_FORMAT_Y10:
+        case UVC_FRAME_FORMAT_Y12:
+        case UVC_FRAME_FORMAT_Y10P:
+        case UVC_FRAME_FORMAT_Y12P:
+            *pDataType = NDUInt16;
+            *pColorMode = NDColorModeMono;
+            return true;
+        case UVC_FRAME_FORMAT_BY8:
+        case UVC_FRAME_FORMAT_BA81:
+        case UVC_FRAME_FORMAT_SGRBG8:
+        case UVC_FRAME_FORMAT_SGBRG8:
+        case UVC_FRAME_FORMAT_SRGGB8:
+        case UVC_FRAME_FORMAT_SBGGR8:
+            *pDataType = NDUInt8;
+            *pColorMode = NDColorModeBayer;
+            return true;
+        case UVC_FRAME_FORMAT_YUYV:
+        case UVC_FRAME_FORMAT_UYVY:
+        case UVC_FRAME_FORMAT_NV12:
+        case UVC_FRAME_FORMAT_P010:
+        case UVC_FRAME_FORMAT_RGB:
+        case UVC_FRAME_FORMAT_BGR:
+        case UVC_FRAME_FORMAT_MJPEG:
+            *pDataType = NDUInt8;
+            *pColorMode = NDColorModeRGB1;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Function that gets the mosaic pattern of a Bayer frame format, as used by the BayerPattern
+ * attribute of raw Bayer NDArrays. BA81 is the V4L2 name of BGGR, while the UVC BY8 format leaves
+ * the pattern to the camera, so it is set with UVCBY8Pattern.
+ *
+ * @params[in]:  frameFormat -> concrete format of the frames received from the camera
+ * @params[in]:  by8Pattern  -> Bayer pattern of BY8 frames
+ * @params[out]: pPattern    -> Bayer pattern
+ * @return: true for Bayer formats, false otherwise
+ */
+bool ADUVC_getBayerPattern(uvc_frame_format frameFormat, NDBayerPattern_t by8Pattern,
+                           NDBayerPattern_t* pPattern) {
+    switch (frameFormat) {
+        case UVC_FRAME_FORMAT_BY8:
+            *pPattern = by8Pattern;
+            return true;
+        case UVC_FRAME_FORMAT_BA81:
+        case UVC_FRAME_FORMAT_SBGGR8:
+            *pPattern = NDBayerBGGR;
+            return true;
+        case UVC_FRAME_FORMAT_SGRBG8:
+            *pPattern = NDBayerGRBG;
+            return true;
+        case UVC_FRAME_FORMAT_SGBRG8:
+            *pPattern = NDBayerGBRG;
+            return true;
+        case UVC_FRAME_FORMAT_SRGGB8:
+            *pPattern = NDBayerRGGB;
+            return true;
+        default:
+            return false;
+    }
+}
+
+//-------------------------------------------------------
+// Binning and orientation
+//-------------------------------------------------------
+
+/*
+ * Function that looks up the kernel converting frame rows to interleaved pixels for a kernel, so
+ * that the rows can be placed in any orientation. Planar RGB is produced from RGB1 rows.
+ *
+ * @params[in]: pKernel -> kernel selected for the NDArray
+ * @return: pointer to the table entry, or NULL for YUV422 and raw copy output
+ */
+const ADUVC_Kernel_t* ADUVC_findRowKernel(const ADUVC_Kernel_t* pKernel) {
+    if (pKernel == NULL || pKernel->frameFormat == UVC_FRAME_FORMAT_ANY) return NULL;
+
+    switch (pKernel->colorMode) {
+        case NDColorModeMono:
+        case NDColorModeBayer:
+        case NDColorModeRGB1:
+            return pKernel;
+        case NDColorModeRGB2:
+        case NDColorModeRGB3:
+            return ADUVC_findKernel(pKernel->frameFormat, pKernel->dataType, NDColorModeRGB1);
+        default:
+            return NULL;
+    }
+}
+
+// True for the Bayer formats, whatever their pattern
+static bool isBayerFormat(uvc_frame_format frameFormat) {
+    NDBayerPattern_t pattern;
+    return ADUVC_getBayerPattern(frameFormat, NDBayerBGGR, &pattern);
+}
+
+/*
+ * Pixels in the smallest group of an input row that starts on a byte boundary and that the row
+ * kernel converts on its own, so that it can be given only the columns of a region. 0 if the row
+ * kernel must convert whole rows, as the Bayer demosaic interpolates across the region edges.
+ */
+static size_t columnGroup(const ADUVC_Kernel_t* pRowKernel) {
+    if (pRowKernel->inBitsPerPixel == 0) return 0;
+    if (isBayerFormat(pRowKernel->frameFormat))
+        return pRowKernel->colorMode == NDColorModeRGB1 ? 0 : 1;
+
+    switch (pRowKernel->frameFormat) {
+        case UVC_FRAME_FORMAT_Y10P:
+            return 4;
+        case UVC_FRAME_FORMAT_Y12P:
+        case UVC_FRAME_FORMAT_YUYV:
+        case UVC_FRAME_FORMAT_UYVY:
+        case UVC_FRAME_FORMAT_NV12:
+        case UVC_FRAME_FORMAT_P010:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+/*
+ * Function that fills the placement of a frame in the NDArray. The region of interest is cropped
+ * first, then binned, then reversed along its own axes and rotated clockwise, which is expressed
+ * as an optional transpose followed by a reversal along the NDArray axes. The region is clipped
+ * to the frame, a region starting past its edge keeping the last column or row of the frame. Raw
+ * Bayer output is never binned, as that would mix the colors of the mosaic. MJPEG regions start
+ * on a multiple of the bin height, so that no bin spans two decode stripes.
+ *
+ * @params[out]: pGeometry  -> geometry to fill
+ * @params[in]:  pKernel    -> kernel selected for the NDArray
+ * @params[in]:  pRowKernel -> kernel found by ADUVC_findRowKernel for pKernel
+ * @params[in]:  width      -> frame width in pixels
+ * @params[in]:  height     -> frame height in pixels
+ * @params[in]:  pTransform -> region, binning and orientation requested for the NDArray
+ * @params[in]:  placeRows  -> place the rows even if the kernel could write the NDArray, so that
+ * statistics can be taken from them
+ * @return: true if rows must be placed with ADUVC_convertPlaced, false if the kernel can write
+ * the NDArray directly
+ */
+bool ADUVC_setupGeometry(ADUVC_Geometry_t* pGeometry, const ADUVC_Kernel_t* pKernel,
+                         const ADUVC_Kernel_t* pRowKernel, size_t width, size_t height,
+                         const ADUVC_Transform_t* pTransform, bool placeRows) {
+    bool reverseX = pTransform->reverseX;
+    bool reverseY = pTransform->reverseY;
+
+    memset(pGeometry, 0, sizeof(*pGeometry));
+    switch (pTransform->rotation) {
+        case ADUVC_Rotate90:
+            pGeometry->transpose = true;
+            pGeometry->reverseX = !reverseY;
+            pGeometry->reverseY = reverseX;
+            break;
+        case ADUVC_Rotate180:
+            pGeometry->reverseX = !reverseX;
+            pGeometry->reverseY = !reverseY;
+            break;
+        case ADUVC_Rotate270:
+            pGeometry->transpose = true;
+            pGeometry->reverseX = reverseY;
+            pGeometry->reverseY = !reverseX;
+            break;
+        default:
+            pGeometry->reverseX = reverseX;
+            pGeometry->reverseY = reverseY;
+            break;
+    }
+
+    bool canBin = pRowKernel != NULL && (pRowKernel->colorMode == NDColorModeRGB1 ||
+                                         !isBayerFormat(pRowKernel->frameFormat));
+    size_t binY = canBin && pTransform->binY > 1 ? pTransform->binY : 1;
+
+    if (width == 0 || height == 0) return false;
+    pGeometry->roiX = pTransform->minX < width ? pTransform->minX : width - 1;
+    pGeometry->roiY = pTransform->minY < height ? pTransform->minY : height - 1;
+    if (pRowKernel != NULL && pRowKernel->inBitsPerPixel == 0)
+        pGeometry->roiY -= pGeometry->roiY % binY;
+    pGeometry->roiWidth = width - pGeometry->roiX;
+    if (pTransform->sizeX > 0 && pTransform->sizeX < pGeometry->roiWidth)
+        pGeometry->roiWidth = pTransform->sizeX;
+    pGeometry->roiHeight = height - pGeometry->roiY;
+    if (pTransform->sizeY > 0 && pTransform->sizeY < pGeometry->roiHeight)
+        pGeometry->roiHeight = pTransform->sizeY;
+    bool cropped = pGeometry->roiWidth < width || pGeometry->roiHeight < height;
+
+    pGeometry->binX = (canBin && pTransform->binX > 1 && pGeometry->roiWidth >= pTransform->binX)
+                          ? pTransform->binX : 1;
+    pGeometry->binY = pGeometry->roiHeight >= binY ? binY : 1;
+    pGeometry->binAverage = pTransform->binAverage;
+    pGeometry->binnedWidth = pGeometry->roiWidth / pGeometry->binX;
+    pGeometry->binnedHeight = pGeometry->roiHeight / pGeometry->binY;
+
+    pGeometry->outWidth = pGeometry->transpose ? pGeometry->binnedHeight : pGeometry->binnedWidth;
+    pGeometry->outHeight = pGeometry->transpose ? pGeometry->binnedWidth : pGeometry->binnedHeight;
+    if (!placeRows && !cropped && !pGeometry->transpose && !pGeometry->reverseX &&
+        !pGeometry->reverseY && pGeometry->binX == 1 && pGeometry->binY == 1)
+        return false;
+    if (pRowKernel == NULL) return false;
+
+    // packed rows are converted from the group of pixels holding the first column of the region
+    size_t group = columnGroup(pRowKernel);
+    if (group > 0) {
+        size_t rowEnd = (pGeometry->roiX + pGeometry->roiWidth + group - 1) / group * group;
+        pGeometry->rowX = pGeometry->roiX / group * group;
+        pGeometry->rowWidth = (rowEnd < width ? rowEnd : width) - pGeometry->rowX;
+        pGeometry->rowOffset = ADUVC_rowBytes(pGeometry->rowX, pRowKernel->inBitsPerPixel);
+    } else {
+        pGeometry->rowX = 0;
+        pGeometry->rowWidth = width;
+        pGeometry->rowOffset = 0;
+    }
+
+    size_t channels = pRowKernel->colorMode == NDColorModeRGB1 ? 3 : 1;
+    size_t elementBytes =
+        (pRowKernel->dataType == NDUInt16 || pRowKernel->dataType == NDInt16) ? 2 : 1;
+    pGeometry->pRowKernel = pRowKernel;
+    pGeometry->pixelBytes = channels * elementBytes;
+    pGeometry->colorMode = pKernel->colorMode;
+    return true;
+}
+
+/*
+ * Writes one row of the binned frame, as interleaved pixels, to its place in the NDArray. A row
+ * is a column of the NDArray when transposed, and is copied as a single block when it lands in
+ * order.
+ */
+static void placeRow(const ADUVC_KernelArgs_t* args, size_t y, const uint8_t* pRow) {
+    const ADUVC_Geometry_t* g = args->pGeometry;
+    const ptrdiff_t w = (ptrdiff_t) g->outWidth;
+    const ptrdiff_t h = (ptrdiff_t) g->outHeight;
+    const size_t channels = g->pixelBytes == 3 ? 3 : 1;
+    const size_t elementBytes = g->pixelBytes / channels;
+
+    // NDArray position of the first pixel of the row, and the step to the next pixel
+    ptrdiff_t xo = g->transpose ? (ptrdiff_t) y : 0, dx = g->transpose ? 0 : 1;
+    ptrdiff_t yo = g->transpose ? 0 : (ptrdiff_t) y, dy = g->transpose ? 1 : 0;
+    if (g->reverseX) {
+        xo = w - 1 - xo;
+        dx = -dx;
+    }
+    if (g->reverseY) {
+        yo = h - 1 - yo;
+        dy = -dy;
+    }
+
+    ptrdiff_t start, step, channelStride;
+    switch (g->colorMode) {
+        case NDColorModeRGB2:
+            start = (yo * 3 * w + xo) * elementBytes;
+            step = (dy * 3 * w + dx) * elementBytes;
+            channelStride = w * elementBytes;
+            break;
+        case NDColorModeRGB3:
+            start = (yo * w + xo) * elementBytes;
+            step = (dy * w + dx) * elementBytes;
+            channelStride = w * h * elementBytes;
+            break;
+        default:
+            start = (yo * w + xo) * g->pixelBytes;
+            step = (dy * w + dx) * g->pixelBytes;
+            channelStride = elementBytes;
+            break;
+    }
+
+    uint8_t* pPixel = (uint8_t*) args->pOut + start;
+    if (step == (ptrdiff_t) g->pixelBytes && channelStride == (ptrdiff_t) elementBytes) {
+        memcpy(pPixel, pRow, g->binnedWidth * g->pixelBytes);
+        return;
+    }
+
+    if (elementBytes == 1) {
+        for (size_t x = 0; x < g->binnedWidth; x++, pPixel += step)
+            for (size_t c = 0; c < channels; c++) pPixel[c * channelStride] = *pRow++;
+    } else {
+        for (size_t x = 0; x < g->binnedWidth; x++, pPixel += step)
+            for (size_t c = 0; c < channels; c++, pRow += elementBytes)
+                memcpy(pPixel + c * channelStride, pRow, elementBytes);
+    }
+}
+
+/*
+ * Adds a frame row of interleaved pixels to the sums of a row of bins, starting the sums over on
+ * the first row of the bins. Pixels past the last whole bin are dropped.
+ */
+template <typename T>
+static void sumBins(const ADUVC_Geometry_t* g, const uint8_t* pRow, uint32_t* pSums,
+                    size_t channels, bool first) {
+    const T* pIn = (const T*) pRow;
+    for (size_t xb = 0; xb < g->binnedWidth; xb++, pIn += g->binX * channels) {
+        for (size_t c = 0; c < channels; c++) {
+            uint32_t sum = first ? 0 : pSums[xb * channels + c];
+            for (size_t i = 0; i < g->binX; i++) sum += pIn[i * channels + c];
+            pSums[xb * channels + c] = sum;
+        }
+    }
+}
+
+// Writes the sums of a row of bins as pixels, averaged or saturated to the range of T
+template <typename T>
+static void finishBins(const ADUVC_Geometry_t* g, const uint32_t* pSums, uint8_t* pRow,
+                       size_t channels) {
+    T* pOut = (T*) pRow;
+    const uint32_t count = (uint32_t) (g->binX * g->binY);
+    const uint32_t maxValue = (T) ~0;
+    for (size_t i = 0; i < g->binnedWidth * channels; i++) {
+        uint32_t value = g->binAverage ? (pSums[i] + count / 2) / count : pSums[i];
+        pOut[i] = (T) (value > maxValue ? maxValue : value);
+    }
+}
+
+/*
+ * Adds a row of the binned frame to the luma statistics, y counting from the top of the binned
+ * region. Sums along the row are kept in integers and added to the moments once per row.
+ */
+template <typename T>
+static void addRowStats(ADUVC_Stats_t* pStats, const ADUVC_Geometry_t* g, size_t y,
+                        const uint8_t* pRow) {
+    const T* pIn = (const T*) pRow;
+    const bool rgb = g->pixelBytes / sizeof(T) == 3;
+    const int histogramShift = (int) sizeof(T) * 8 - 8;
+    uint64_t sum = 0, sumX = 0, sumXX = 0;
+    uint32_t minValue = pStats->min, maxValue = pStats->max;
+
+    for (uint64_t x = 0; x < g->binnedWidth; x++) {
+        uint32_t luma;
+        if (rgb) {
+            // BT.601 weights in 8 bit fixed point
+            luma = (77 * (uint32_t) pIn[0] + 150 * (uint32_t) pIn[1] + 29 * (uint32_t) pIn[2] +
+                    128) >> 8;
+            pIn += 3;
+        } else {
+            luma = *pIn++;
+        }
+        sum += luma;
+        sumX += luma * x;
+        sumXX += luma * x * x;
+        if (luma < minValue) minValue = luma;
+        if (luma > maxValue) maxValue = luma;
+        pStats->histogram[luma >> histogramShift]++;
+    }
+
+    pStats->count += g->binnedWidth;
+    pStats->sum += sum;
+    pStats->min = minValue;
+    pStats->max = maxValue;
+    pStats->sumX += (double) sumX;
+    pStats->sumXX += (double) sumXX;
+    pStats->sumY += (double) sum * y;
+    pStats->sumYY += (double) sum * y * y;
+}
+
+/* Buffers of one thread placing rows, see ADUVC_convertPlaced */
+typedef struct ADUVC_PLACER {
+    const ADUVC_KernelArgs_t* args;
+    uint8_t* pRow;          // frame row converted by the row kernel
+    uint8_t* pBinned;       // row of the binned frame
+    uint32_t* pSums;        // sums of the current row of bins
+    ADUVC_Stats_t* pStats;  // statistics the placed rows are added to, or NULL
+} ADUVC_Placer_t;
+
+// Adds a row of the binned frame to the statistics of the placer, and writes it to the NDArray
+static void finishRow(ADUVC_Placer_t* pPlacer, size_t y, const uint8_t* pRow) {
+    const ADUVC_Geometry_t* g = pPlacer->args->pGeometry;
+    if (pPlacer->pStats != NULL) {
+        if (g->pixelBytes == 2)
+            addRowStats<uint16_t>(pPlacer->pStats, g, y, pRow);
+        else
+            addRowStats<uint8_t>(pPlacer->pStats, g, y, pRow);
+    }
+    placeRow(pPlacer->args, y, pRow);
+}
+
+// Bytes of the buffers of a placer for a geometry
+static size_t placerBytes(const ADUVC_Geometry_t* g) {
+    const size_t channels = g->pixelBytes == 3 ? 3 : 1;
+    return g->binnedWidth * channels * sizeof(uint32_t) + g->binnedWidth * g->pixelBytes +
+           g->rowWidth * g->pixelBytes;
+}
+
+// Points a placer at its buffers, reserved with ADUVC_reservePlaceBuffers
+static void initPlacer(ADUVC_Placer_t* pPlacer, const ADUVC_KernelArgs_t* args,
+                       ADUVC_PlaceBuffers_t* pBuffers) {
+    const ADUVC_Geometry_t* g = args->pGeometry;
+    const size_t channels = g->pixelBytes == 3 ? 3 : 1;
+    pPlacer->args = args;
+    pPlacer->pStats = NULL;
+    pPlacer->pSums = (uint32_t*) pBuffers->pData;
+    pPlacer->pBinned = pBuffers->pData + g->binnedWidth * channels * sizeof(uint32_t);
+    pPlacer->pRow = pPlacer->pBinned + g->binnedWidth * g->pixelBytes;
+}
+
+/*
+ * Takes one row of the region as interleaved pixels, y counting from the top of the region.
+ * Without binning the row is placed right away, otherwise it is added to the current row of bins,
+ * which is placed after its last row.
+ */
+static void addRow(ADUVC_Placer_t* pPlacer, size_t y, const uint8_t* pRow) {
+    const ADUVC_Geometry_t* g = pPlacer->args->pGeometry;
+    if (g->binX == 1 && g->binY == 1) {
+        finishRow(pPlacer, y, pRow);
+        return;
+    }
+    if (y / g->binY >= g->binnedHeight) return;
+
+    const size_t channels = g->pixelBytes == 3 ? 3 : 1;
+    const bool wide = g->pixelBytes / channels == 2;
+    if (wide)
+        sumBins<uint16_t>(g, pRow, pPlacer->pSums, channels, y % g->binY == 0);
+    else
+        sumBins<uint8_t>(g, pRow, pPlacer->pSums, channels, y % g->binY == 0);
+    if (y % g->binY != g->binY - 1) return;
+
+    if (wide)
+        finishBins<uint16_t>(g, pPlacer->pSums, pPlacer->pBinned, channels);
+    else
+        finishBins<uint8_t>(g, pPlacer->pSums, pPlacer->pBinned, channels);
+    finishRow(pPlacer, y / g->binY, pPlacer->pBinned);
+}
+
+// Row callback of the MJPEG decoder, each stripe has its own placer
+static void placeScanline(uint32_t row, const uint8_t* pScanline, int stripe, void* pPlacers) {
+    ADUVC_Placer_t* pPlacer = &((ADUVC_Placer_t*) pPlacers)[stripe];
+    addRow(pPlacer, row - pPlacer->args->pGeometry->roiY, pScanline);
+}
+
+/*
+ * Function that makes the buffers of each band or MJPEG stripe large enough to place the rows of
+ * a geometry. Buffers only grow, so they are reallocated when the geometry changes rather than
+ * for every frame. Called by the owner of the buffers before ADUVC_convertPlaced.
+ *
+ * @params[in]: pBuffers  -> buffers to reserve
+ * @params[in]: count     -> number of buffers used, up to ADUVC_MAX_PLACE_BUFFERS
+ * @params[in]: pGeometry -> geometry set by ADUVC_setupGeometry
+ * @return: false if the memory could not be allocated
+ */
+bool ADUVC_reservePlaceBuffers(ADUVC_PlaceBuffers_t* pBuffers, int count,
+                               const ADUVC_Geometry_t* pGeometry) {
+    const size_t bytes = placerBytes(pGeometry);
+    for (int i = 0; i < count; i++) {
+        if (pBuffers[i].capacity >= bytes) continue;
+        free(pBuffers[i].pData);
+        pBuffers[i].pData = (uint8_t*) malloc(bytes);
+        pBuffers[i].capacity = pBuffers[i].pData != NULL ? bytes : 0;
+        if (pBuffers[i].pData == NULL) return false;
+    }
+    return true;
+}
+
+/*
+ * Function that frees the buffers reserved by ADUVC_reservePlaceBuffers.
+ *
+ * @params[in]: pBuffers -> buffers to free
+ * @params[in]: count    -> number of buffers
+ * @return: void
+ */
+void ADUVC_freePlaceBuffers(ADUVC_PlaceBuffers_t* pBuffers, int count) {
+    for (int i = 0; i < count; i++) {
+        free(pBuffers[i].pData);
+        pBuffers[i].pData = NULL;
+        pBuffers[i].capacity = 0;
+    }
+}
+
+/*
+ * Function that converts the rows of the region in the band [firstRow, lastRow) one row at a
+ * time with the row kernel of the geometry, bins the rows while they are in cache and writes
+ * them straight to their place in the NDArray. Only the columns of the region are converted when
+ * the input format allows it. A band handles the rows of bins that start inside it, so bands may
+ * read frame rows past their end. For MJPEG frames only the region is decoded, and placed
+ * scanline by scanline, ignoring the band; their stripes start on multiples of 8 rows, so binning
+ * by 2 or 4 never spans two stripes. If args->pStats is set, the placed rows are also added to
+ * args->pStats[args->band], each MJPEG stripe first gathering its own. A band works in
+ * args->pPlaceBuffers[args->band] and an MJPEG stripe in the buffer of its index, so no memory is
+ * allocated here.
+ *
+ * @params[in]: args -> arguments for the band, with pGeometry set by ADUVC_setupGeometry and the
+ * buffers of each band or stripe reserved for it by ADUVC_reservePlaceBuffers
+ * @return: UVC_SUCCESS, or the error returned by the row kernel
+ */
+uvc_error_t ADUVC_convertPlaced(ADUVC_KernelArgs_t* args) {
+    const ADUVC_Geometry_t* g = args->pGeometry;
+    const size_t outBytes = g->outWidth * g->outHeight * g->pixelBytes;
+    if (args->outBytes < outBytes) return UVC_ERROR_NO_MEM;
+    uvc_error_t status = UVC_SUCCESS;
+
+    if (g->pRowKernel->inBitsPerPixel == 0) {
+        int numPlacers = args->decodeThreads > 1 ? args->decodeThreads : 1;
+        if (numPlacers > ADUVC_MAX_PLACE_BUFFERS) numPlacers = ADUVC_MAX_PLACE_BUFFERS;
+        ADUVC_Placer_t placers[ADUVC_MAX_PLACE_BUFFERS];
+        for (int i = 0; i < numPlacers; i++) {
+            initPlacer(&placers[i], args, &args->pPlaceBuffers[i]);
+            if (args->pStats != NULL) {
+                ADUVC_clearStats(&args->pPlaceBuffers[i].stats);
+                placers[i].pStats = &args->pPlaceBuffers[i].stats;
+            }
+        }
+
+        uvc_frame_format format =
+            g->pixelBytes == 3 ? UVC_FRAME_FORMAT_RGB : UVC_FRAME_FORMAT_GRAY8;
+        status = uvc_mjpeg_decode_region(args->frame, format, numPlacers, g->roiX, g->roiY,
+                                         g->roiWidth, g->roiHeight, placeScanline, placers);
+
+        for (int i = 0; i < numPlacers && args->pStats != NULL; i++)
+            ADUVC_mergeStats(&args->pStats[args->band], &args->pPlaceBuffers[i].stats);
+        return status;
+    }
+
+    ADUVC_Placer_t placer;
+    initPlacer(&placer, args, &args->pPlaceBuffers[args->band]);
+    if (args->pStats != NULL) placer.pStats = &args->pStats[args->band];
+
+    // the row kernel sees a frame starting at column rowX
+    uvc_frame_t rowFrame = *args->frame;
+    rowFrame.data = (uint8_t*) args->frame->data + g->rowOffset;
+    rowFrame.data_bytes = args->frame->data_bytes - g->rowOffset;
+
+    ADUVC_KernelArgs_t rowArgs = *args;
+    rowArgs.frame = &rowFrame;
+    rowArgs.width = g->rowWidth;
+    rowArgs.pOut = placer.pRow;
+    rowArgs.outBytes = g->rowWidth * g->pixelBytes;
+    const uint8_t* pRegion = placer.pRow + (g->roiX - g->rowX) * g->pixelBytes;
+
+    size_t firstRow = args->firstRow > g->roiY ? args->firstRow - g->roiY : 0;
+    for (size_t yb = (firstRow + g->binY - 1) / g->binY;
+         yb < g->binnedHeight && g->roiY + yb * g->binY < args->lastRow && status == UVC_SUCCESS;
+         yb++) {
+        for (size_t y = yb * g->binY; y < (yb + 1) * g->binY && status == UVC_SUCCESS; y++) {
+            rowArgs.firstRow = g->roiY + y;
+            rowArgs.lastRow = g->roiY + y + 1;
+            rowArgs.outFirstRow = g->roiY + y;
+            status = g->pRowKernel->convert(&rowArgs);
+            if (status == UVC_SUCCESS) addRow(&placer, y, pRegion);
+        }
+    }
+    return status;
+}
+
+/*
+ * Function that empties statistics before the rows of a frame are added to them.
+ *
+ * @params[out]: pStats -> statistics to clear
+ * @return: void
+ */
+void ADUVC_clearStats(ADUVC_Stats_t* pStats) {
+    memset(pStats, 0, sizeof(*pStats));
+    pStats->min = (uint32_t) ~0;
+}
+
+/*
+ * Function that adds the statistics gathered by one band or stripe of a frame to those of the
+ * rest of the frame.
+ *
+ * @params[in,out]: pDest -> statistics of the frame
+ * @params[in]:     pSrc  -> statistics of one part of the frame
+ * @return: void
+ */
+void ADUVC_mergeStats(ADUVC_Stats_t* pDest, const ADUVC_Stats_t* pSrc) {
+    pDest->count += pSrc->count;
+    pDest->sum += pSrc->sum;
+    if (pSrc->min < pDest->min) pDest->min = pSrc->min;
+    if (pSrc->max > pDest->max) pDest->max = pSrc->max;
+    pDest->sumX += pSrc->sumX;
+    pDest->sumY += pSrc->sumY;
+    pDest->sumXX += pSrc->sumXX;
+    pDest->sumYY += pSrc->sumYY;
+    for (size_t i = 0; i < ADUVC_STATS_HISTOGRAM_BINS; i++)
+        pDest->histogram[i] += pSrc->histogram[i];
+}
+
+/*
+ * Function that computes the published statistics of a frame. The centroid and sigma are first
+ * taken along the binned region, then moved to the NDArray axes by the transpose and reversals of
+ * the geometry. A frame without any luma has its centroid at the origin and no spread.
+ *
+ * @params[in]:  pStats    -> statistics of the whole frame
+ * @params[in]:  pGeometry -> placement of the frame in the NDArray
+ * @params[out]: pResult   -> statistics to publish
+ * @return: void
+ */
+void ADUVC_finishStats(const ADUVC_Stats_t* pStats, const ADUVC_Geometry_t* pGeometry,
+                       ADUVC_StatsResult_t* pResult) {
+    const ADUVC_Geometry_t* g = pGeometry;
+    memset(pResult, 0, sizeof(*pResult));
+    if (pStats->count == 0) return;
+
+    pResult->total = (double) pStats->sum;
+    pResult->mean = pResult->total / (double) pStats->count;
+    pResult->min = pStats->min;
+    pResult->max = pStats->max;
+    if (pStats->sum == 0) return;
+
+    double centroidX = pStats->sumX / pResult->total;
+    double centroidY = pStats->sumY / pResult->total;
+    double varianceX = pStats->sumXX / pResult->total - centroidX * centroidX;
+    double varianceY = pStats->sumYY / pResult->total - centroidY * centroidY;
+    double sigmaX = varianceX > 0 ? sqrt(varianceX) : 0;
+    double sigmaY = varianceY > 0 ? sqrt(varianceY) : 0;
+
+    if (g->transpose) {
+        double swap = centroidX;
+        centroidX = centroidY;
+        centroidY = swap;
+        swap = sigmaX;
+        sigmaX = sigmaY;
+        sigmaY = swap;
+    }
+    pResult->centroidX = g->reverseX ? (double) g->outWidth - 1 - centroidX : centroidX;
+    pResult->centroidY = g->reverseY ? (double) g->outHeight - 1 - centroidY : centroidY;
+    pResult->sigmaX = sigmaX;
+    pResult->sigmaY = sigmaY;
+}
+
+/*
+ * Function that gets the Bayer pattern of a frame after it is cropped and placed in the NDArray,
+ * from the position the top left red sample of the region is moved to.
+ *
+ * @params[in]: pattern   -> Bayer pattern of the frame
+ * @params[in]: pGeometry -> placement of the frame
+ * @return: Bayer pattern of the NDArray
+ */
+NDBayerPattern_t ADUVC_orientBayerPattern(NDBayerPattern_t pattern,
+                                          const ADUVC_Geometry_t* pGeometry) {
+    size_t redX = (pattern == NDBayerGRBG || pattern == NDBayerBGGR) ? 1 : 0;
+    size_t redY = (pattern == NDBayerGBRG || pattern == NDBayerBGGR) ? 1 : 0;
+
+    // position in the region
+    redX ^= pGeometry->roiX & 1;
+    redY ^= pGeometry->roiY & 1;
+    if (pGeometry->transpose) {
+        size_t swap = redX;
+        redX = redY;
+        redY = swap;
+    }
+    if (pGeometry->reverseX) redX = (pGeometry->outWidth - 1 - redX) & 1;
+    if (pGeometry->reverseY) redY = (pGeometry->outHeight - 1 - redY) & 1;
+
+    if (redY == 0) return redX == 0 ? NDBayerRGGB : NDBayerGRBG;
+    return redX == 0 ? NDBayerGBRG : NDBayerBGGR;
+}
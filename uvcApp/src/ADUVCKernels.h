@@ -0,0 +1,396 @@
+/*
+ * Header file for the ADUVC frame conversion kernels
+ *
+ * Every supported combination of uvc frame format, NDDataType and NDColorMode is handled by its
+ * own kernel, instantiated from the templates below so that pixel layouts and channel orders are
+ * compile time constants. The kernel table in ADUVCKernels.cpp is searched once when acquisition
+ * starts, and the selected function is then called for every frame.
+ *
+ * Copyright (c) : 2018-2025 Brookhaven National Laboratory
+ *
+ */
+
+// header guard
+#ifndef ADUVC_KERNELS_H
+#define ADUVC_KERNELS_H
+
+#include <stdint.h>
+#include <string.h>
+
+// includes
+extern "C" {
+#include "libuvc/libuvc.h"
+}
+
+#include "NDArray.h"
+
+/* Y'CbCr to RGB conversion matrices */
+typedef enum ADUVC_COLOR_MATRIX {
+    ADUVC_ColorMatrixBT601Full = 0,
+    ADUVC_ColorMatrixBT601Limited = 1,
+    ADUVC_ColorMatrixBT709Full = 2,
+    ADUVC_ColorMatrixBT709Limited = 3,
+} ADUVC_ColorMatrix_t;
+
+/* Per-component lookup tables for one color matrix. Entries are in 16.16 fixed point, and the
+ * luma table includes the rounding offset, so that R = (y[Y] + rV[Cr]) >> 16 and so on.
+ * The same matrix is also given as Q13 coefficients for SIMD kernels, which multiply samples
+ * scaled by 64 and keep the high 16 bits of the product. */
+typedef struct ADUVC_YUV_TABLES {
+    int32_t y[256];
+    int32_t rV[256];
+    int32_t gU[256];
+    int32_t gV[256];
+    int32_t bU[256];
+    int16_t yOffset;  // luma black level, scaled by 64
+    int16_t yCoef;
+    int16_t rVCoef;
+    int16_t gUCoef;
+    int16_t gVCoef;
+    int16_t bUCoef;
+} ADUVC_YUVTables_t;
+
+// Fills the lookup tables for a color matrix
+void ADUVC_buildYUVTables(ADUVC_YUVTables_t* pTables, ADUVC_ColorMatrix_t matrix);
+
+/* Rotation of the NDArray relative to the frame, clockwise */
+typedef enum ADUVC_ROTATION {
+    ADUVC_Rotate0 = 0,
+    ADUVC_Rotate90 = 1,
+    ADUVC_Rotate180 = 2,
+    ADUVC_Rotate270 = 3,
+} ADUVC_Rotation_t;
+
+typedef struct ADUVC_GEOMETRY ADUVC_Geometry_t;
+typedef struct ADUVC_PLACE_BUFFERS ADUVC_PlaceBuffers_t;
+
+// Most bands or MJPEG stripes placed at once by ADUVC_convertPlaced
+#define ADUVC_MAX_PLACE_BUFFERS 16
+
+// Number of histogram bins, spread over the full range of the NDArray data type
+#define ADUVC_STATS_HISTOGRAM_BINS 256
+
+/* Luma statistics of the pixels placed in the NDArray. Luma is the sample itself for Mono and
+ * Bayer frames. Moments are taken along the rows and columns of the binned region, and are
+ * turned into NDArray coordinates by ADUVC_finishStats. */
+typedef struct ADUVC_STATS {
+    uint64_t count;  // pixels added
+    uint64_t sum;    // sum of luma
+    uint32_t min;    // smallest luma
+    uint32_t max;    // largest luma
+    double sumX;     // sum of luma times column
+    double sumY;     // sum of luma times row
+    double sumXX;    // sum of luma times column squared
+    double sumYY;    // sum of luma times row squared
+    uint32_t histogram[ADUVC_STATS_HISTOGRAM_BINS];
+} ADUVC_Stats_t;
+
+/* Statistics of a frame, as published by the driver */
+typedef struct ADUVC_STATS_RESULT {
+    double total;
+    double mean;
+    double min;
+    double max;
+    double centroidX;  // NDArray column of the luma centroid
+    double centroidY;  // NDArray row of the luma centroid
+    double sigmaX;     // luma weighted standard deviation along NDArray rows
+    double sigmaY;     // luma weighted standard deviation along NDArray columns
+} ADUVC_StatsResult_t;
+
+/* Arguments passed to a conversion kernel for a single frame */
+typedef struct ADUVC_KERNEL_ARGS {
+    uvc_frame_t* frame;                   // frame received from the camera
+    void* pOut;                           // NDArray buffer to convert into
+    size_t outBytes;                      // size of the NDArray buffer
+    size_t width;                         // frame width in pixels
+    size_t height;                        // frame height in pixels
+    size_t inStep;                        // bytes between input rows, 0 for compressed frames
+    size_t firstRow;                      // first row to convert
+    size_t lastRow;                       // one past the last row to convert
+    int decodeThreads;                    // maximum number of threads used to decode an MJPEG frame
+    uvc_frame_t* pScratch;                // scratch frame for kernels that convert in two passes
+    const ADUVC_YUVTables_t* pYUVTables;  // color matrix for Y'CbCr to RGB kernels
+    int bitShift;                         // right shift applied to 16 bit greyscale samples
+    NDBayerPattern_t by8Pattern;          // mosaic pattern of BY8 frames
+    size_t outFirstRow;                   // frame row written at the start of pOut
+    const ADUVC_Geometry_t* pGeometry;    // placement of rows for ADUVC_convertPlaced
+    int band;                             // index of the band of rows converted by this call
+    ADUVC_Stats_t* pStats;                // statistics of each band, NULL to skip them
+    ADUVC_PlaceBuffers_t* pPlaceBuffers;  // buffers of each band or MJPEG stripe that is placed
+} ADUVC_KernelArgs_t;
+
+typedef uvc_error_t (*ADUVC_KernelFunc_t)(ADUVC_KernelArgs_t* args);
+
+/* Entry of the kernel table */
+typedef struct ADUVC_KERNEL {
+    uvc_frame_format frameFormat;  // input format, UVC_FRAME_FORMAT_ANY for the raw copy fallback
+    NDDataType_t dataType;         // NDArray data type produced
+    NDColorMode_t colorMode;       // NDArray color mode produced
+    size_t inBitsPerPixel;         // bits per input pixel, 0 for compressed formats
+    ADUVC_KernelFunc_t convert;    // conversion function
+    const char* name;              // name used in reports
+} ADUVC_Kernel_t;
+
+// Looks up the kernel for a combination, NULL if it is not supported
+const ADUVC_Kernel_t* ADUVC_findKernel(uvc_frame_format frameFormat, NDDataType_t dataType,
+                                       NDColorMode_t colorMode);
+
+/* Region, binning and orientation requested for the NDArray, applied in this order */
+typedef struct ADUVC_TRANSFORM {
+    size_t minX;                // first column of the region of interest
+    size_t minY;                // first row of the region of interest
+    size_t sizeX;               // width of the region of interest, 0 for the whole frame
+    size_t sizeY;               // height of the region of interest, 0 for the whole frame
+    size_t binX;                // frame pixels per NDArray pixel horizontally, 1, 2 or 4
+    size_t binY;                // frame pixels per NDArray pixel vertically, 1, 2 or 4
+    bool binAverage;            // average binned pixels instead of summing them
+    bool reverseX;              // mirror the frame left to right
+    bool reverseY;              // mirror the frame top to bottom
+    ADUVC_Rotation_t rotation;  // clockwise rotation applied after the mirroring
+} ADUVC_Transform_t;
+
+/* Placement of converted rows in the NDArray, for cropped or binned frames, or orientations other
+ * than the frame's own. The columns of each row of the region are converted to interleaved pixels
+ * by the row kernel, and rows of bins are summed while in cache. Rows of the binned region are
+ * written to the NDArray as the binned region transposed (if set), then reversed along the
+ * NDArray axes. */
+struct ADUVC_GEOMETRY {
+    const ADUVC_Kernel_t* pRowKernel;  // kernel converting frame rows to interleaved pixels
+    size_t pixelBytes;                 // bytes per pixel produced by the row kernel
+    NDColorMode_t colorMode;           // NDArray color mode
+    size_t roiX;                       // first column of the region
+    size_t roiY;                       // first row of the region
+    size_t roiWidth;                   // width of the region in pixels
+    size_t roiHeight;                  // height of the region in pixels
+    size_t rowX;                       // first column converted by the row kernel, up to roiX
+    size_t rowWidth;                   // columns converted by the row kernel
+    size_t rowOffset;                  // bytes from the start of an input row to column rowX
+    size_t binX;                       // frame pixels per binned pixel horizontally
+    size_t binY;                       // frame pixels per binned pixel vertically
+    bool binAverage;                   // average binned pixels instead of summing them
+    size_t binnedWidth;                // binned region width in pixels
+    size_t binnedHeight;               // binned region height in pixels
+    size_t outWidth;                   // NDArray width in pixels
+    size_t outHeight;                  // NDArray height in pixels
+    bool transpose;                    // binned region rows become NDArray columns
+    bool reverseX;                     // NDArray columns are reversed
+    bool reverseY;                     // NDArray rows are reversed
+};
+
+// Looks up the kernel producing interleaved rows for a kernel, NULL if its rows cannot be placed
+const ADUVC_Kernel_t* ADUVC_findRowKernel(const ADUVC_Kernel_t* pKernel);
+
+// Fills the geometry for a frame size and transform, false if the kernel can write the NDArray
+bool ADUVC_setupGeometry(ADUVC_Geometry_t* pGeometry, const ADUVC_Kernel_t* pKernel,
+                         const ADUVC_Kernel_t* pRowKernel, size_t width, size_t height,
+                         const ADUVC_Transform_t* pTransform, bool placeRows);
+
+/* Working buffers of ADUVC_convertPlaced for one band of rows or MJPEG stripe. They are kept
+ * from frame to frame, and only reallocated when a geometry needs more room. */
+struct ADUVC_PLACE_BUFFERS {
+    uint8_t* pData;       // sums of a row of bins, binned row and converted row
+    size_t capacity;      // bytes allocated at pData
+    ADUVC_Stats_t stats;  // statistics gathered by an MJPEG stripe
+};
+
+// Makes the first count buffers large enough for a geometry, false if out of memory
+bool ADUVC_reservePlaceBuffers(ADUVC_PlaceBuffers_t* pBuffers, int count,
+                               const ADUVC_Geometry_t* pGeometry);
+
+// Frees the first count buffers
+void ADUVC_freePlaceBuffers(ADUVC_PlaceBuffers_t* pBuffers, int count);
+
+// Converts the rows of args with the row kernel, and places them as given by args->pGeometry
+uvc_error_t ADUVC_convertPlaced(ADUVC_KernelArgs_t* args);
+
+// Empties statistics before a frame
+void ADUVC_clearStats(ADUVC_Stats_t* pStats);
+
+// Adds the statistics of one part of a frame to another
+void ADUVC_mergeStats(ADUVC_Stats_t* pDest, const ADUVC_Stats_t* pSrc);
+
+// Computes the published statistics of a frame, in NDArray coordinates
+void ADUVC_finishStats(const ADUVC_Stats_t* pStats, const ADUVC_Geometry_t* pGeometry,
+                       ADUVC_StatsResult_t* pResult);
+
+// Gets the Bayer pattern of a frame once placed in the NDArray
+NDBayerPattern_t ADUVC_orientBayerPattern(NDBayerPattern_t pattern,
+                                          const ADUVC_Geometry_t* pGeometry);
+
+// Gets the data type and color mode that keep the full depth of a format, false if unknown
+bool ADUVC_getNativeOutput(uvc_frame_format frameFormat, NDDataType_t* pDataType,
+                           NDColorMode_t* pColorMode);
+
+// Gets the mosaic pattern of a Bayer format, false for other formats. UVC does not define the
+// pattern of BY8, so it is given by the caller
+bool ADUVC_getBayerPattern(uvc_frame_format frameFormat, NDBayerPattern_t by8Pattern,
+                           NDBayerPattern_t* pPattern);
+
+/* Bytes in a row of width pixels. Packed formats are padded to a whole group of pixels, e.g. 4
+ * pixels in 5 bytes for 10 bits per pixel. */
+static inline size_t ADUVC_rowBytes(size_t width, size_t bitsPerPixel) {
+    size_t groupPixels = 1;
+    while ((groupPixels * bitsPerPixel) % 8 != 0) groupPixels *= 2;
+    return (width + groupPixels - 1) / groupPixels * groupPixels * bitsPerPixel / 8;
+}
+
+//-------------------------------------------------------
+// Pixel layouts
+//-------------------------------------------------------
+
+/* Byte offsets of a pixel pair in packed 4:2:2 formats */
+struct ADUVC_YUYVLayout {
+    static const int y0 = 0, u = 1, y1 = 2, v = 3;
+};
+
+struct ADUVC_UYVYLayout {
+    static const int u = 0, y0 = 1, v = 2, y1 = 3;
+};
+
+/* Output pointers and pixel stride for each RGB color mode. y counts from args->outFirstRow. */
+template <NDColorMode_t ColorMode>
+struct ADUVC_RGBLayout;
+
+template <>
+struct ADUVC_RGBLayout<NDColorModeRGB1> {
+    static const size_t pixelStride = 3;
+    static inline void rows(const ADUVC_KernelArgs_t* args, size_t y, uint8_t** pR, uint8_t** pG,
+                            uint8_t** pB) {
+        *pR = (uint8_t*) args->pOut + y * args->width * 3;
+        *pG = *pR + 1;
+        *pB = *pR + 2;
+    }
+};
+
+template <>
+struct ADUVC_RGBLayout<NDColorModeRGB2> {
+    static const size_t pixelStride = 1;
+    static inline void rows(const ADUVC_KernelArgs_t* args, size_t y, uint8_t** pR, uint8_t** pG,
+                            uint8_t** pB) {
+        *pR = (uint8_t*) args->pOut + y * args->width * 3;
+        *pG = *pR + args->width;
+        *pB = *pG + args->width;
+    }
+};
+
+template <>
+struct ADUVC_RGBLayout<NDColorModeRGB3> {
+    static const size_t pixelStride = 1;
+    static inline void rows(const ADUVC_KernelArgs_t* args, size_t y, uint8_t** pR, uint8_t** pG,
+                            uint8_t** pB) {
+        size_t plane = args->width * args->height;
+        *pR = (uint8_t*) args->pOut + y * args->width;
+        *pG = *pR + plane;
+        *pB = *pG + plane;
+    }
+};
+
+static inline uint8_t ADUVC_saturate(int value) {
+    return (uint8_t) (value >= 255 ? 255 : (value < 0 ? 0 : value));
+}
+
+//-------------------------------------------------------
+// Kernel templates
+//-------------------------------------------------------
+
+/*
+ * Copies rows unchanged. Used whenever the input already has the NDArray layout.
+ */
+template <size_t BytesPerPixel>
+uvc_error_t ADUVC_copyRows(ADUVC_KernelArgs_t* args) {
+    const uint8_t* pIn = (const uint8_t*) args->frame->data;
+    size_t rowBytes = args->width * BytesPerPixel;
+    uint8_t* pOut = (uint8_t*) args->pOut;
+
+    if (args->inStep == rowBytes) {
+        memcpy(pOut + (args->firstRow - args->outFirstRow) * rowBytes,
+               pIn + args->firstRow * rowBytes, (args->lastRow - args->firstRow) * rowBytes);
+    } else {
+        for (size_t y = args->firstRow; y < args->lastRow; y++)
+            memcpy(pOut + (y - args->outFirstRow) * rowBytes, pIn + y * args->inStep, rowBytes);
+    }
+    return UVC_SUCCESS;
+}
+
+/*
+ * Converts packed 4:2:2 Y'CbCr to 8 bit RGB with the lookup tables of the selected color matrix,
+ * writing straight into the requested RGB layout.
+ */
+template <class Layout, NDColorMode_t ColorMode>
+uvc_error_t ADUVC_yuv422ToRGB(ADUVC_KernelArgs_t* args) {
+    const size_t s = ADUVC_RGBLayout<ColorMode>::pixelStride;
+    const ADUVC_YUVTables_t* t = args->pYUVTables;
+
+    for (size_t y = args->firstRow; y < args->lastRow; y++) {
+        const uint8_t* pIn = (const uint8_t*) args->frame->data + y * args->inStep;
+        uint8_t *pR, *pG, *pB;
+        ADUVC_RGBLayout<ColorMode>::rows(args, y - args->outFirstRow, &pR, &pG, &pB);
+
+        for (size_t x = 0; x < args->width; x += 2) {
+            int32_t r = t->rV[pIn[Layout::v]];
+            int32_t g = t->gU[pIn[Layout::u]] + t->gV[pIn[Layout::v]];
+            int32_t b = t->bU[pIn[Layout::u]];
+            int32_t y0 = t->y[pIn[Layout::y0]];
+
+            pR[0] = ADUVC_saturate((y0 + r) >> 16);
+            pG[0] = ADUVC_saturate((y0 + g) >> 16);
+            pB[0] = ADUVC_saturate((y0 + b) >> 16);
+            if (x + 1 < args->width) {
+                int32_t y1 = t->y[pIn[Layout::y1]];
+                pR[s] = ADUVC_saturate((y1 + r) >> 16);
+                pG[s] = ADUVC_saturate((y1 + g) >> 16);
+                pB[s] = ADUVC_saturate((y1 + b) >> 16);
+            }
+            pIn += 4;
+            pR += 2 * s;
+            pG += 2 * s;
+            pB += 2 * s;
+        }
+    }
+    return UVC_SUCCESS;
+}
+
+/*
+ * Reorders interleaved 8 bit RGB or BGR into the requested RGB layout.
+ */
+template <bool SwapRB, NDColorMode_t ColorMode>
+uvc_error_t ADUVC_rgbToRGB(ADUVC_KernelArgs_t* args) {
+    const size_t s = ADUVC_RGBLayout<ColorMode>::pixelStride;
+
+    for (size_t y = args->firstRow; y < args->lastRow; y++) {
+        const uint8_t* pIn = (const uint8_t*) args->frame->data + y * args->inStep;
+        uint8_t *pR, *pG, *pB;
+        ADUVC_RGBLayout<ColorMode>::rows(args, y - args->outFirstRow, &pR, &pG, &pB);
+
+        for (size_t x = 0; x < args->width; x++) {
+            *pR = pIn[SwapRB ? 2 : 0];
+            *pG = pIn[1];
+            *pB = pIn[SwapRB ? 0 : 2];
+            pIn += 3;
+            pR += s;
+            pG += s;
+            pB += s;
+        }
+    }
+    return UVC_SUCCESS;
+}
+
+/*
+ * Decodes an MJPEG frame to interleaved RGB in the scratch frame, then splits it into the planar
+ * RGB2 or RGB3 layout.
+ */
+template <NDColorMode_t ColorMode>
+uvc_error_t ADUVC_mjpegToPlanarRGB(ADUVC_KernelArgs_t* args) {
+    uvc_error_t status =
+        uvc_mjpeg2rgb_threaded(args->frame, args->pScratch, args->decodeThreads);
+    if (status != UVC_SUCCESS) return status;
+
+    ADUVC_KernelArgs_t rgbArgs = *args;
+    rgbArgs.frame = args->pScratch;
+    rgbArgs.inStep = args->pScratch->step;
+    rgbArgs.firstRow = 0;
+    rgbArgs.lastRow = args->height;
+    return ADUVC_rgbToRGB<false, ColorMode>(&rgbArgs);
+}
+
+#endif
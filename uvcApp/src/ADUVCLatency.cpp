@@ -0,0 +1,138 @@
+/*
+ * Per-stage latency histograms used by the ADUVC driver
+ *
+ * Copyright (c) : 2018-2025 Brookhaven National Laboratory
+ *
+ */
+
+#include "ADUVCLatency.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+static const char* stageNames[ADUVC_NUM_LATENCY_STAGES] = {"ASSEMBLE", "HANDOFF", "QUEUE",
+                                                           "DECODE",   "PUBLISH", "TOTAL"};
+
+// Time points each stage is measured between
+static const int stageBegin[ADUVC_NUM_LATENCY_STAGES] = {
+    ADUVC_TimeTransfer, ADUVC_TimeSwap,    ADUVC_TimeCallback,
+    ADUVC_TimeAlloc,    ADUVC_TimeDecoded, ADUVC_TimeTransfer};
+static const int stageEnd[ADUVC_NUM_LATENCY_STAGES] = {
+    ADUVC_TimeSwap,    ADUVC_TimeCallback,  ADUVC_TimeAlloc,
+    ADUVC_TimeDecoded, ADUVC_TimePublished, ADUVC_TimePublished};
+
+uint64_t ADUVC_monotonicNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ADUVC_timespecNs(&now);
+}
+
+uint64_t ADUVC_timespecNs(const struct timespec* pTime) {
+    return (uint64_t) pTime->tv_sec * 1000000000 + (uint64_t) pTime->tv_nsec;
+}
+
+uint64_t ADUVC_threadCpuNs() {
+    struct timespec used;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &used) != 0) return 0;
+    return ADUVC_timespecNs(&used);
+}
+
+const char* ADUVC_latencyStageName(int stage) { return stageNames[stage]; }
+
+/*
+ * Function that finds the histogram bin of a latency, four bins per octave.
+ *
+ * @params[in]: us  -> latency in microseconds
+ * @return: bin index, clamped to the last bin
+ */
+static int latencyBin(uint32_t us) {
+    if (us < 1) return 0;
+    int octave = 0;
+    while ((us >> octave) > 1) octave++;
+    int bin = 4 * octave + (int) (((uint64_t) us << 2) >> octave) - 4;
+    return bin < ADUVC_LATENCY_BINS ? bin : ADUVC_LATENCY_BINS - 1;
+}
+
+ADUVCLatency::ADUVCLatency() { this->lock = epicsMutexMustCreate(); }
+
+ADUVCLatency::~ADUVCLatency() { epicsMutexDestroy(this->lock); }
+
+/*
+ * Function that adds the latency of each stage of a published frame to the window, replacing the
+ * oldest frame once the window is full. Stages with an end before their beginning, for example
+ * after a clock step, are counted as 0.
+ *
+ * @params[in]: pTimes  -> times of the frame at each point
+ * @return: void
+ */
+void ADUVCLatency::addFrame(const ADUVC_FrameTimes_t* pTimes) {
+    uint32_t us[ADUVC_NUM_LATENCY_STAGES];
+    for (int stage = 0; stage < ADUVC_NUM_LATENCY_STAGES; stage++) {
+        uint64_t begin = pTimes->ns[stageBegin[stage]];
+        uint64_t end = pTimes->ns[stageEnd[stage]];
+        if (begin == 0 || end == 0)
+            us[stage] = ADUVC_LATENCY_MISSING;
+        else if (end <= begin)
+            us[stage] = 0;
+        else
+            us[stage] = (uint32_t) std::min<uint64_t>((end - begin) / 1000,
+                                                      ADUVC_LATENCY_MISSING - 1);
+    }
+
+    epicsMutexLock(this->lock);
+    int slot = this->numFrames % ADUVC_LATENCY_WINDOW;
+    for (int stage = 0; stage < ADUVC_NUM_LATENCY_STAGES; stage++)
+        this->samples[stage][slot] = us[stage];
+    this->numFrames++;
+    if (this->numFrames == 2 * ADUVC_LATENCY_WINDOW) this->numFrames = ADUVC_LATENCY_WINDOW;
+    epicsMutexUnlock(this->lock);
+}
+
+/*
+ * Function that computes the median, 99th percentile and maximum latency of a stage over the
+ * frames in the window, and its histogram. Percentiles are taken by nearest rank.
+ *
+ * @params[in]:  stage      -> stage to summarize
+ * @params[out]: pSummary   -> percentiles in milliseconds, all 0 if no frame measured the stage
+ * @params[out]: histogram  -> ADUVC_LATENCY_BINS counts of frames
+ * @return: void
+ */
+void ADUVCLatency::summarize(int stage, ADUVC_LatencySummary_t* pSummary, epicsInt32* histogram) {
+    uint32_t window[ADUVC_LATENCY_WINDOW];
+    int numSamples = 0;
+
+    epicsMutexLock(this->lock);
+    int numFrames = std::min(this->numFrames, ADUVC_LATENCY_WINDOW);
+    for (int i = 0; i < numFrames; i++) {
+        uint32_t us = this->samples[stage][i];
+        if (us != ADUVC_LATENCY_MISSING) window[numSamples++] = us;
+    }
+    epicsMutexUnlock(this->lock);
+
+    memset(histogram, 0, ADUVC_LATENCY_BINS * sizeof(epicsInt32));
+    memset(pSummary, 0, sizeof(ADUVC_LatencySummary_t));
+    pSummary->numFrames = numSamples;
+    if (numSamples == 0) return;
+
+    for (int i = 0; i < numSamples; i++) histogram[latencyBin(window[i])]++;
+
+    int p50 = (numSamples + 1) / 2 - 1;
+    int p99 = (numSamples * 99 + 99) / 100 - 1;
+    std::nth_element(window, window + p99, window + numSamples);
+    pSummary->p99 = window[p99] / 1000.0;
+    pSummary->max = *std::max_element(window + p99, window + numSamples) / 1000.0;
+    std::nth_element(window, window + p50, window + p99);
+    pSummary->p50 = window[p50] / 1000.0;
+}
+
+/*
+ * Function that empties the window, so that the latencies only cover frames published from now on.
+ *
+ * @return: void
+ */
+void ADUVCLatency::reset() {
+    epicsMutexLock(this->lock);
+    this->numFrames = 0;
+    epicsMutexUnlock(this->lock);
+}
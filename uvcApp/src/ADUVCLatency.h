@@ -0,0 +1,101 @@
+/*
+ * Header file for the ADUVC per-stage latency histograms
+ *
+ * Each published frame is timestamped from the USB transfer that completed it to the return of
+ * the NDArray callbacks. The time spent in each stage is kept for a rolling window of recent
+ * frames, from which histograms and percentiles are published.
+ *
+ * Copyright (c) : 2018-2025 Brookhaven National Laboratory
+ *
+ */
+
+// header guard
+#ifndef ADUVC_LATENCY_H
+#define ADUVC_LATENCY_H
+
+#include <epicsMutex.h>
+#include <epicsTypes.h>
+#include <stdint.h>
+#include <time.h>
+
+// Number of recent frames the latency of each stage is computed over
+#define ADUVC_LATENCY_WINDOW 1024
+
+// Histogram bins. Bin 4 * k + j counts latencies from 2^k * (4 + j) / 4 microseconds up to the
+// next bin, so each octave from 1 us to 16 s is split in four
+#define ADUVC_LATENCY_BINS 96
+
+// Stored in place of the latency of a stage that was not timestamped
+#define ADUVC_LATENCY_MISSING ((uint32_t) ~0)
+
+/* Points in the life of a frame at which it is timestamped, on the monotonic clock */
+typedef enum ADUVC_TIME_POINT {
+    ADUVC_TimeTransfer = 0,   // USB transfer completing the frame received by libuvc
+    ADUVC_TimeSwap = 1,       // frame handed to the libuvc callback thread
+    ADUVC_TimeCallback = 2,   // frame callback entered
+    ADUVC_TimeAlloc = 3,      // NDArray allocated by the convert thread
+    ADUVC_TimeDecoded = 4,    // frame converted into the NDArray
+    ADUVC_TimePublished = 5,  // NDArray callbacks returned
+} ADUVC_TimePoint_t;
+
+#define ADUVC_NUM_TIME_POINTS 6
+
+/* Stages measured, between consecutive time points, and over the whole pipeline */
+typedef enum ADUVC_LATENCY_STAGE {
+    ADUVC_StageAssemble = 0,  // transfer to swap, libuvc assembling the frame
+    ADUVC_StageHandoff = 1,   // swap to callback, libuvc copying the frame to its callback
+    ADUVC_StageQueue = 2,     // callback to allocation, waiting for the convert thread
+    ADUVC_StageDecode = 3,    // allocation to decoded, converting the frame
+    ADUVC_StagePublish = 4,   // decoded to published, waiting for and running the plugins
+    ADUVC_StageTotal = 5,     // transfer to published
+} ADUVC_LatencyStage_t;
+
+#define ADUVC_NUM_LATENCY_STAGES 6
+
+/* Times of a frame at each point, in nanoseconds, 0 where it was not timestamped */
+typedef struct ADUVC_FRAME_TIMES {
+    uint64_t ns[ADUVC_NUM_TIME_POINTS];
+} ADUVC_FrameTimes_t;
+
+/* Latency of a stage over the window, in milliseconds */
+typedef struct ADUVC_LATENCY_SUMMARY {
+    double p50;
+    double p99;
+    double max;
+    int numFrames;  // frames in the window
+} ADUVC_LatencySummary_t;
+
+// Current time on the clock libuvc timestamps frames with, in nanoseconds
+uint64_t ADUVC_monotonicNs();
+
+// Converts a libuvc timestamp to nanoseconds, 0 if it is unset
+uint64_t ADUVC_timespecNs(const struct timespec* pTime);
+
+// CPU time used by the calling thread, in nanoseconds
+uint64_t ADUVC_threadCpuNs();
+
+// Name of a stage, as used in its PV names
+const char* ADUVC_latencyStageName(int stage);
+
+class ADUVCLatency {
+   public:
+    ADUVCLatency();
+    ~ADUVCLatency();
+
+    // Adds the latency of each stage of a published frame
+    void addFrame(const ADUVC_FrameTimes_t* pTimes);
+
+    // Computes the percentiles and histogram of a stage over the window
+    void summarize(int stage, ADUVC_LatencySummary_t* pSummary, epicsInt32* histogram);
+
+    // Empties the window
+    void reset();
+
+   private:
+    // Latency of each stage in microseconds, ADUVC_LATENCY_MISSING if it was not measured
+    uint32_t samples[ADUVC_NUM_LATENCY_STAGES][ADUVC_LATENCY_WINDOW];
+    int numFrames = 0;
+    epicsMutexId lock;
+};
+
+#endif
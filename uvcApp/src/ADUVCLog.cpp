@@ -0,0 +1,207 @@
+/*
+ * Asynchronous, rate limited logger used by the ADUVC driver
+ *
+ * Copyright (c) : 2018-2025 Brookhaven National Laboratory
+ *
+ */
+
+#include "ADUVCLog.h"
+
+#include <epicsAtomic.h>
+#include <epicsStdio.h>
+#include <epicsThread.h>
+#include <errlog.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "ADUVCLatency.h"
+
+ADUVCLog::ADUVCLog(const char* driverName) {
+    this->driverName = driverName;
+    for (size_t i = 0; i < ADUVC_LOG_QUEUE_SIZE; i++) this->messages[i].sequence = i;
+    this->wakeEvent = epicsEventMustCreate(epicsEventEmpty);
+    this->doneEvent = epicsEventMustCreate(epicsEventEmpty);
+}
+
+ADUVCLog::~ADUVCLog() {
+    stop();
+    epicsEventDestroy(this->wakeEvent);
+    epicsEventDestroy(this->doneEvent);
+}
+
+/*
+ * Function that starts the thread writing out queued messages.
+ *
+ * @params[in]: pasynUser   -> asynUser of the driver, errors are printed through its asyn trace
+ * @return: void
+ */
+void ADUVCLog::start(asynUser* pasynUser) {
+    if (this->running) return;
+    this->pasynUser = pasynUser;
+    epicsAtomicSetIntT(&this->exitThread, 0);
+    this->running = epicsThreadCreate("ADUVC_log", epicsThreadPriorityLow,
+                                      epicsThreadGetStackSize(epicsThreadStackSmall),
+                                      ADUVCLog::logThreadC, this) != NULL;
+}
+
+/*
+ * Function that stops the logging thread, once it has written out the messages still queued.
+ * Messages posted afterwards stay queued until the next call.
+ *
+ * @return: void
+ */
+void ADUVCLog::stop() {
+    if (this->running) {
+        epicsAtomicSetIntT(&this->exitThread, 1);
+        epicsEventSignal(this->wakeEvent);
+        epicsEventWait(this->doneEvent);
+        this->running = false;
+    }
+    drain();
+}
+
+/*
+ * Function that counts a message against the rate limit of its call site. The limit applies to
+ * fixed windows, and is approximate when several threads log from the site at once.
+ *
+ * @params[in]:  pSite          -> rate limit of the call site
+ * @params[out]: pSuppressed    -> messages suppressed at the site since the last one let through
+ * @return: true if the message may be logged
+ */
+bool ADUVCLog::admit(ADUVC_LogSite_t* pSite, size_t* pSuppressed) {
+    size_t window = (size_t) (ADUVC_monotonicNs() / ADUVC_LOG_WINDOW_NS);
+    size_t siteWindow = epicsAtomicGetSizeT(&pSite->window);
+    if (window != siteWindow &&
+        epicsAtomicCmpAndSwapSizeT(&pSite->window, siteWindow, window) == siteWindow)
+        epicsAtomicSetIntT(&pSite->count, 0);
+
+    if (epicsAtomicIncrIntT(&pSite->count) > ADUVC_LOG_BURST) {
+        epicsAtomicIncrSizeT(&pSite->suppressed);
+        epicsAtomicIncrSizeT(&this->suppressed);
+        return false;
+    }
+
+    size_t suppressed = epicsAtomicGetSizeT(&pSite->suppressed);
+    while (suppressed != 0) {
+        size_t previous = epicsAtomicCmpAndSwapSizeT(&pSite->suppressed, suppressed, 0);
+        if (previous == suppressed) break;
+        suppressed = previous;
+    }
+    *pSuppressed = suppressed;
+    return true;
+}
+
+/*
+ * Function that formats a message into the queue. A producer claims the slot at head once the
+ * logging thread has freed it, when its sequence equals the position, and hands it over by
+ * setting the sequence to the position plus one. Never waits: the message is dropped if the slot
+ * has not been freed yet, which means the queue is full.
+ *
+ * @params[in]: pSite           -> rate limit of the call site
+ * @params[in]: level           -> severity of the message
+ * @params[in]: functionName    -> function the message is logged from, must outlive the message
+ * @params[in]: fmt             -> printf style format of the message, and its arguments
+ * @return: void
+ */
+void ADUVCLog::post(ADUVC_LogSite_t* pSite, ADUVC_LogLevel_t level, const char* functionName,
+                    const char* fmt, ...) {
+    size_t siteSuppressed;
+    if (!admit(pSite, &siteSuppressed)) return;
+
+    size_t position = epicsAtomicGetSizeT(&this->head);
+    ADUVC_LogMessage_t* pMessage;
+    while (true) {
+        pMessage = &this->messages[position & (ADUVC_LOG_QUEUE_SIZE - 1)];
+        size_t sequence = epicsAtomicGetSizeT(&pMessage->sequence);
+        epicsAtomicReadMemoryBarrier();
+        if (sequence == position) {
+            size_t claimed = epicsAtomicCmpAndSwapSizeT(&this->head, position, position + 1);
+            if (claimed == position) break;
+            position = claimed;
+        } else if (sequence < position) {
+            // the suppressed count is kept for the next message from the site
+            epicsAtomicAddSizeT(&pSite->suppressed, siteSuppressed);
+            epicsAtomicIncrSizeT(&this->dropped);
+            return;
+        } else
+            position = epicsAtomicGetSizeT(&this->head);
+    }
+
+    pMessage->level = level;
+    pMessage->functionName = functionName;
+    pMessage->suppressed = siteSuppressed;
+    va_list args;
+    va_start(args, fmt);
+    epicsVsnprintf(pMessage->text, sizeof(pMessage->text), fmt, args);
+    va_end(args);
+    epicsAtomicWriteMemoryBarrier();
+    epicsAtomicSetSizeT(&pMessage->sequence, position + 1);
+}
+
+size_t ADUVCLog::getSuppressed() { return epicsAtomicGetSizeT(&this->suppressed); }
+
+size_t ADUVCLog::getDropped() { return epicsAtomicGetSizeT(&this->dropped); }
+
+/*
+ * Function that prints a message, errors through the asyn trace of the driver and everything else
+ * through errlog.
+ *
+ * @params[in]: pMessage -> message taken from the queue
+ * @return: void
+ */
+void ADUVCLog::write(const ADUVC_LogMessage_t* pMessage) {
+    const char* levelName = "DEBUG";
+    if (pMessage->level <= ADUVC_LOG_LEVEL_ERROR)
+        levelName = "ERROR";
+    else if (pMessage->level <= ADUVC_LOG_LEVEL_WARNING)
+        levelName = "WARNING";
+    else if (pMessage->level <= ADUVC_LOG_LEVEL_INFO)
+        levelName = "INFO";
+
+    char suppressed[64] = "";
+    if (pMessage->suppressed > 0)
+        epicsSnprintf(suppressed, sizeof(suppressed), " (%lu similar messages suppressed)",
+                      (unsigned long) pMessage->suppressed);
+
+    if (pMessage->level <= ADUVC_LOG_LEVEL_ERROR && this->pasynUser != NULL)
+        asynPrint(this->pasynUser, ASYN_TRACE_ERROR, "%s | %s::%s: %s%s\n", levelName,
+                  this->driverName, pMessage->functionName, pMessage->text, suppressed);
+    else
+        errlogPrintf("%s | %s::%s: %s%s\n", levelName, this->driverName, pMessage->functionName,
+                     pMessage->text, suppressed);
+}
+
+/*
+ * Function that writes out queued messages in order, and frees their slots. Only called by one
+ * thread at a time: the logging thread, or the caller of stop() once it has exited.
+ *
+ * @return: void
+ */
+void ADUVCLog::drain() {
+    while (true) {
+        ADUVC_LogMessage_t* pMessage = &this->messages[this->tail & (ADUVC_LOG_QUEUE_SIZE - 1)];
+        if (epicsAtomicGetSizeT(&pMessage->sequence) != this->tail + 1) break;
+        epicsAtomicReadMemoryBarrier();
+        write(pMessage);
+        epicsAtomicWriteMemoryBarrier();
+        epicsAtomicSetSizeT(&pMessage->sequence, this->tail + ADUVC_LOG_QUEUE_SIZE);
+        this->tail++;
+    }
+}
+
+/*
+ * Body of the logging thread. Writes out the queue every ADUVC_LOG_DRAIN_PERIOD, so that logging
+ * threads never have to signal it, until stop() is called.
+ */
+void ADUVCLog::logThread() {
+    while (!epicsAtomicGetIntT(&this->exitThread)) {
+        epicsEventWaitWithTimeout(this->wakeEvent, ADUVC_LOG_DRAIN_PERIOD);
+        drain();
+    }
+    epicsEventSignal(this->doneEvent);
+}
+
+void ADUVCLog::logThreadC(void* pPvt) {
+    ADUVCLog* pLog = (ADUVCLog*) pPvt;
+    pLog->logThread();
+}
@@ -0,0 +1,106 @@
+/*
+ * Header file for the ADUVC asynchronous logger
+ *
+ * Log messages are formatted by the thread that logs them into a fixed size queue, and written
+ * out by a background thread, so that logging never waits on console or file I/O. The queue is
+ * lock free: a message that finds it full is dropped and counted instead. Each place a message is
+ * logged from is also limited to a burst of messages per second, with the messages over the limit
+ * counted and reported with the next one let through.
+ *
+ * Copyright (c) : 2018-2025 Brookhaven National Laboratory
+ *
+ */
+
+// header guard
+#ifndef ADUVC_LOG_H
+#define ADUVC_LOG_H
+
+#include <asynDriver.h>
+#include <compilerDependencies.h>
+#include <epicsEvent.h>
+#include <stddef.h>
+
+// Messages that may wait for the logging thread. Must be a power of two
+#define ADUVC_LOG_QUEUE_SIZE 256
+
+// Longest message, longer ones are truncated
+#define ADUVC_LOG_MESSAGE_LEN 256
+
+// Messages each call site may log per window before the rest are suppressed
+#define ADUVC_LOG_BURST 10
+#define ADUVC_LOG_WINDOW_NS 1000000000ULL
+
+// Seconds the logging thread sleeps between writing out the queue
+#define ADUVC_LOG_DRAIN_PERIOD 0.1
+
+typedef enum ADUVC_LOG_LEVEL {
+    ADUVC_LOG_LEVEL_NONE = 0,
+    ADUVC_LOG_LEVEL_ERROR = 10,
+    ADUVC_LOG_LEVEL_WARNING = 20,
+    ADUVC_LOG_LEVEL_INFO = 30,
+    ADUVC_LOG_LEVEL_DEBUG = 40
+} ADUVC_LogLevel_t;
+
+/* Rate limit of one call site, shared by every thread logging from it */
+typedef struct ADUVC_LOG_SITE {
+    size_t window;      // window the count applies to, in ADUVC_LOG_WINDOW_NS since boot
+    int count;          // messages logged from the site in the window
+    size_t suppressed;  // messages suppressed since the last one let through
+} ADUVC_LogSite_t;
+
+/* Message waiting for the logging thread */
+typedef struct ADUVC_LOG_MESSAGE {
+    size_t sequence;           // queue position the slot is ready for, see ADUVCLog::post
+    ADUVC_LogLevel_t level;    // severity of the message
+    const char* functionName;  // function the message was logged from
+    size_t suppressed;         // messages from the same site suppressed before this one
+    char text[ADUVC_LOG_MESSAGE_LEN];
+} ADUVC_LogMessage_t;
+
+class ADUVCLog {
+   public:
+    ADUVCLog(const char* driverName);
+    ~ADUVCLog();
+
+    // Starts the logging thread. Messages posted before are kept until it starts
+    void start(asynUser* pasynUser);
+
+    // Writes out the messages still queued and stops the logging thread
+    void stop();
+
+    // Queues a message unless its call site is over its rate limit or the queue is full. Never
+    // blocks
+    void post(ADUVC_LogSite_t* pSite, ADUVC_LogLevel_t level, const char* functionName,
+              const char* fmt, ...) EPICS_PRINTF_STYLE(5, 6);
+
+    // Messages suppressed by the rate limits, and dropped because the queue was full
+    size_t getSuppressed();
+    size_t getDropped();
+
+   private:
+    bool admit(ADUVC_LogSite_t* pSite, size_t* pSuppressed);
+    void write(const ADUVC_LogMessage_t* pMessage);
+    void drain();
+    void logThread();
+    static void logThreadC(void* pPvt);
+
+    const char* driverName;
+    asynUser* pasynUser = NULL;
+
+    // Bounded multi-producer queue. Producers claim a position by advancing head, and the logging
+    // thread reads from tail. Each slot's sequence says whether it is free for a producer or ready
+    // for the logging thread
+    ADUVC_LogMessage_t messages[ADUVC_LOG_QUEUE_SIZE];
+    size_t head = 0;
+    size_t tail = 0;
+
+    size_t suppressed = 0;
+    size_t dropped = 0;
+
+    epicsEventId wakeEvent = NULL;
+    epicsEventId doneEvent = NULL;
+    bool running = false;
+    int exitThread = 0;
+};
+
+#endif
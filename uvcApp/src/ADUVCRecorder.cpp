@@ -0,0 +1,109 @@
+/*
+ * Flight recorder of the frames received by the ADUVC driver
+ *
+ * Copyright (c) : 2018-2025 Brookhaven National Laboratory
+ *
+ */
+
+#include "ADUVCRecorder.h"
+
+#include <epicsAtomic.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char* eventNames[ADUVC_NUM_FRAME_EVENTS] = {
+    "published", "decimated",   "no_buffer",     "copy_failed",
+    "stale",     "image_limit", "convert_failed"};
+
+/*
+ * Function that starts the trace of a frame received from libuvc.
+ *
+ * @params[in]:  frame          -> frame passed to the frame callback
+ * @params[in]:  callbackTime   -> monotonic time the frame callback was entered, in ns
+ * @params[out]: pTrace         -> trace of the frame, with the later points left at 0
+ * @return: void
+ */
+void ADUVC_traceFrame(ADUVC_FrameTrace_t* pTrace, const uvc_frame_t* frame,
+                      uint64_t callbackTime) {
+    memset(pTrace, 0, sizeof(ADUVC_FrameTrace_t));
+    pTrace->times.ns[ADUVC_TimeTransfer] = ADUVC_timespecNs(&frame->transfer_time_finished);
+    pTrace->times.ns[ADUVC_TimeSwap] = ADUVC_timespecNs(&frame->capture_time_finished);
+    pTrace->times.ns[ADUVC_TimeCallback] = callbackTime;
+    pTrace->sequence = frame->sequence;
+    pTrace->pts = frame->pts;
+    pTrace->scr = frame->scr;
+    pTrace->bytes = (uint32_t) frame->data_bytes;
+}
+
+ADUVCRecorder::ADUVCRecorder() { memset(this->slots, 0, sizeof(this->slots)); }
+
+/*
+ * Function that records what happened to a frame, overwriting the oldest record. Each writer
+ * claims its own slot, and marks it incomplete while it fills it in, so that no lock is needed.
+ *
+ * @params[in]: pTrace  -> what is known of the frame
+ * @params[in]: event   -> whether it was published, or why it was dropped
+ * @return: void
+ */
+void ADUVCRecorder::record(const ADUVC_FrameTrace_t* pTrace, ADUVC_FrameEvent_t event) {
+    size_t index = epicsAtomicIncrSizeT(&this->numRecords) - 1;
+    ADUVC_RecorderSlot_t* pSlot = &this->slots[index & (ADUVC_RECORDER_SIZE - 1)];
+
+    epicsAtomicSetSizeT(&pSlot->stamp, 0);
+    epicsAtomicWriteMemoryBarrier();
+    pSlot->record.time = ADUVC_monotonicNs();
+    pSlot->record.trace = *pTrace;
+    pSlot->record.event = event;
+    epicsAtomicWriteMemoryBarrier();
+    epicsAtomicSetSizeT(&pSlot->stamp, index + 1);
+}
+
+/*
+ * Function that writes the records of the last seconds to a file, in the CSV format described in
+ * ADUVCRecorder.h. Records being written, or overwritten while the ring is read, are left out.
+ *
+ * @params[in]: fileName    -> file to create or overwrite
+ * @params[in]: seconds     -> how far back to go, everything still in the ring if 0 or less
+ * @params[in]: portName    -> port of the driver, written in the comment line
+ * @return: number of records written, or -1 if the file could not be written
+ */
+int ADUVCRecorder::dump(const char* fileName, double seconds, const char* portName) {
+    FILE* fp = fopen(fileName, "w");
+    if (fp == NULL) return -1;
+
+    uint64_t now = ADUVC_monotonicNs();
+    uint64_t since = 0;
+    if (seconds > 0 && seconds * 1e9 < (double) now) since = now - (uint64_t) (seconds * 1e9);
+
+    size_t last = epicsAtomicGetSizeT(&this->numRecords);
+    size_t first = last > ADUVC_RECORDER_SIZE ? last - ADUVC_RECORDER_SIZE : 0;
+
+    fprintf(fp, "# ADUVC flight recorder of port %s, times in ns on the monotonic clock\n",
+            portName);
+    fprintf(fp,
+            "time,event,sequence,pts,scr,bytes,transfer,swap,callback,alloc,decoded,published\n");
+
+    int written = 0;
+    for (size_t index = first; index < last; index++) {
+        ADUVC_RecorderSlot_t* pSlot = &this->slots[index & (ADUVC_RECORDER_SIZE - 1)];
+        size_t stamp = epicsAtomicGetSizeT(&pSlot->stamp);
+        epicsAtomicReadMemoryBarrier();
+        ADUVC_FrameRecord_t record = pSlot->record;
+        epicsAtomicReadMemoryBarrier();
+        if (stamp != index + 1 || epicsAtomicGetSizeT(&pSlot->stamp) != stamp) continue;
+        if (record.time < since || record.event >= ADUVC_NUM_FRAME_EVENTS) continue;
+
+        const uint64_t* times = record.trace.times.ns;
+        fprintf(fp, "%llu,%s,%u,%u,%u,%u", (unsigned long long) record.time,
+                eventNames[record.event], record.trace.sequence, record.trace.pts,
+                record.trace.scr, record.trace.bytes);
+        for (int point = 0; point < ADUVC_NUM_TIME_POINTS; point++)
+            fprintf(fp, ",%llu", (unsigned long long) times[point]);
+        fprintf(fp, "\n");
+        written++;
+    }
+
+    bool failed = ferror(fp) != 0;
+    if (fclose(fp) != 0 || failed) return -1;
+    return written;
+}
@@ -0,0 +1,98 @@
+/*
+ * Header file for the ADUVC flight recorder
+ *
+ * Every frame received from libuvc leaves one record in a fixed size ring when it is published or
+ * dropped: its libuvc sequence number, device time stamps, size, the times it reached each
+ * stage and why it was dropped. The ring is written without locks by the pipeline threads, and can
+ * be dumped to a file after an incident, from the UVCRecorderDump PV or the ADUVCDumpRecorder
+ * iocsh command.
+ *
+ * Dump files are CSV. The first line is a comment starting with '#', the second the column names:
+ *
+ *   time       monotonic time the frame was published or dropped, in ns
+ *   event      published, decimated, no_buffer, copy_failed, stale, image_limit or
+ *              convert_failed (see ADUVC_FrameEvent_t)
+ *   sequence   libuvc frame sequence number
+ *   pts        presentation time stamp from the payload headers, 0 if the camera sends none
+ *   scr        source time clock from the payload headers, 0 if the camera sends none
+ *   bytes      bytes in the frame received from libuvc
+ *   transfer, swap, callback, alloc, decoded, published
+ *              monotonic time the frame reached each point (see ADUVC_TimePoint_t), in ns, 0 if
+ *              it did not
+ *
+ * with one line per record, in the order they were recorded.
+ *
+ * Copyright (c) : 2018-2025 Brookhaven National Laboratory
+ *
+ */
+
+// header guard
+#ifndef ADUVC_RECORDER_H
+#define ADUVC_RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ADUVCLatency.h"
+#include "libuvc/libuvc.h"
+
+// Records kept, the most recent frames. Must be a power of two
+#define ADUVC_RECORDER_SIZE 8192
+
+/* What happened to a frame */
+typedef enum ADUVC_FRAME_EVENT {
+    ADUVC_EventPublished = 0,      // NDArray callbacks returned
+    ADUVC_EventDecimated = 1,      // dropped by UVCDecimation or AcquirePeriod
+    ADUVC_EventNoBuffer = 2,       // dropped, all frame buffers waiting for conversion
+    ADUVC_EventCopyFailed = 3,     // dropped, copy from libuvc failed
+    ADUVC_EventStale = 4,          // dropped, acquisition stopped or restarted while queued
+    ADUVC_EventImageLimit = 5,     // dropped, single or multiple image mode already has its images
+    ADUVC_EventConvertFailed = 6,  // dropped, no kernel, no NDArray or conversion failed
+} ADUVC_FrameEvent_t;
+
+#define ADUVC_NUM_FRAME_EVENTS 7
+
+/* What is known of a frame as it goes through the pipeline */
+typedef struct ADUVC_FRAME_TRACE {
+    ADUVC_FrameTimes_t times;  // monotonic time of the frame at each point so far
+    uint32_t sequence;         // libuvc sequence number
+    uint32_t pts;              // presentation time stamp
+    uint32_t scr;              // source time clock of the source clock reference
+    uint32_t bytes;            // bytes received from libuvc
+} ADUVC_FrameTrace_t;
+
+/* One record of the ring */
+typedef struct ADUVC_FRAME_RECORD {
+    uint64_t time;  // monotonic time of the event, in ns
+    ADUVC_FrameTrace_t trace;
+    uint32_t event;  // ADUVC_FrameEvent_t
+} ADUVC_FrameRecord_t;
+
+// Fills in the trace of a frame received from libuvc, timestamped at each point up to the callback
+void ADUVC_traceFrame(ADUVC_FrameTrace_t* pTrace, const uvc_frame_t* frame, uint64_t callbackTime);
+
+class ADUVCRecorder {
+   public:
+    ADUVCRecorder();
+
+    // Records what happened to a frame. May be called from any thread
+    void record(const ADUVC_FrameTrace_t* pTrace, ADUVC_FrameEvent_t event);
+
+    // Writes the records of the last seconds to a CSV file
+    int dump(const char* fileName, double seconds, const char* portName);
+
+   private:
+    /* Slot of the ring. stamp is 0 while the record is being written, and the index of the record
+     * plus one once it is complete */
+    typedef struct ADUVC_RECORDER_SLOT {
+        size_t stamp;
+        ADUVC_FrameRecord_t record;
+    } ADUVC_RecorderSlot_t;
+
+    ADUVC_RecorderSlot_t slots[ADUVC_RECORDER_SIZE];
+
+    // Records written since the driver started
+    size_t numRecords = 0;
+};
+
+#endif
@@ -0,0 +1,141 @@
+/*
+ * Row band thread pool used by the ADUVC driver to convert large frames on several cores
+ *
+ * Copyright (c) : 2018-2025 Brookhaven National Laboratory
+ *
+ */
+
+#include <epicsAtomic.h>
+#include <epicsStdio.h>
+
+#include "ADUVCLatency.h"
+#include "ADUVCThreadPool.h"
+
+ADUVCThreadPool::ADUVCThreadPool() {}
+
+ADUVCThreadPool::~ADUVCThreadPool() { stopWorkers(); }
+
+size_t ADUVCThreadPool::getCpuUs() { return epicsAtomicGetSizeT(&this->cpuUs); }
+
+/*
+ * Body of each worker thread. Waits for a band, converts it and signals the caller, until told to
+ * exit. Adds the CPU time of each band to the total of the pool, in whole microseconds so that the
+ * remainder carries over to the next band.
+ *
+ * @params[in]: pWorker -> the ADUVC_BandWorker_t owned by this thread
+ */
+void ADUVCThreadPool::workerThreadC(void* pWorker) {
+    ADUVC_BandWorker_t* worker = (ADUVC_BandWorker_t*) pWorker;
+    uint64_t lastCpuNs = ADUVC_threadCpuNs();
+
+    while (true) {
+        epicsEventWait(worker->startEvent);
+        if (worker->exit) break;
+        worker->status = worker->convert(&worker->args);
+
+        size_t usedUs = (size_t) ((ADUVC_threadCpuNs() - lastCpuNs) / 1000);
+        epicsAtomicAddSizeT(worker->pCpuUs, usedUs);
+        lastCpuNs += (uint64_t) usedUs * 1000;
+        epicsEventSignal(worker->doneEvent);
+    }
+    epicsEventSignal(worker->doneEvent);
+}
+
+/*
+ * Joins all worker threads and releases their events.
+ */
+void ADUVCThreadPool::stopWorkers() {
+    for (int i = 0; i < this->numWorkers; i++) {
+        this->workers[i].exit = true;
+        epicsEventSignal(this->workers[i].startEvent);
+        epicsEventWait(this->workers[i].doneEvent);
+        epicsEventDestroy(this->workers[i].startEvent);
+        epicsEventDestroy(this->workers[i].doneEvent);
+    }
+    this->numWorkers = 0;
+}
+
+/*
+ * Function that sets the number of threads converting a frame. Threads are started or joined
+ * right away, so this must not be called while run() is in progress.
+ *
+ * @params[in]: numThreads  -> number of threads including the caller, clamped to
+ * [1, ADUVC_MAX_CONVERT_THREADS]
+ * @return: void
+ */
+void ADUVCThreadPool::setNumThreads(int numThreads) {
+    if (numThreads < 1) numThreads = 1;
+    if (numThreads > ADUVC_MAX_CONVERT_THREADS) numThreads = ADUVC_MAX_CONVERT_THREADS;
+    if (numThreads == getNumThreads()) return;
+
+    stopWorkers();
+
+    for (int i = 0; i < numThreads - 1; i++) {
+        ADUVC_BandWorker_t* worker = &this->workers[i];
+        char threadName[32];
+        epicsSnprintf(threadName, sizeof(threadName), "ADUVC_band%d", i + 1);
+
+        worker->startEvent = epicsEventMustCreate(epicsEventEmpty);
+        worker->doneEvent = epicsEventMustCreate(epicsEventEmpty);
+        worker->exit = false;
+        worker->pCpuUs = &this->cpuUs;
+        worker->thread = epicsThreadCreate(threadName, epicsThreadPriorityMedium,
+                                           epicsThreadGetStackSize(epicsThreadStackMedium),
+                                           ADUVCThreadPool::workerThreadC, worker);
+        if (worker->thread == NULL) {
+            epicsEventDestroy(worker->startEvent);
+            epicsEventDestroy(worker->doneEvent);
+            break;
+        }
+        this->numWorkers++;
+    }
+}
+
+/*
+ * Function that converts the rows [firstRow, lastRow) of args in parallel bands. Bands have an
+ * even number of rows, so that vertically subsampled chroma is never split between two threads.
+ * Falls back to a single call of the kernel when the frame is too small to split. Bands are
+ * numbered from args->band, the first one converted by the caller.
+ *
+ * @params[in]: convert     -> kernel to run. Must only touch its own band of rows
+ * @params[in]: args        -> arguments for the whole frame
+ * @params[in]: minBandRows -> smallest band worth handing to another thread
+ * @return: UVC_SUCCESS, or the first error returned by a band
+ */
+uvc_error_t ADUVCThreadPool::run(ADUVC_KernelFunc_t convert, const ADUVC_KernelArgs_t* args,
+                                 size_t minBandRows) {
+    size_t rows = args->lastRow - args->firstRow;
+    if (minBandRows < 1) minBandRows = 1;
+
+    size_t numBands = rows / minBandRows;
+    if (numBands > (size_t) getNumThreads()) numBands = getNumThreads();
+    if (numBands <= 1) {
+        ADUVC_KernelArgs_t bandArgs = *args;
+        return convert(&bandArgs);
+    }
+
+    size_t bandRows = (rows + numBands - 1) / numBands;
+    bandRows += bandRows & 1;
+
+    // hand bands 1..n-1 to the workers, then convert band 0 on this thread
+    int started = 0;
+    for (size_t first = args->firstRow + bandRows; first < args->lastRow; first += bandRows) {
+        ADUVC_BandWorker_t* worker = &this->workers[started++];
+        worker->convert = convert;
+        worker->args = *args;
+        worker->args.firstRow = first;
+        worker->args.lastRow = first + bandRows < args->lastRow ? first + bandRows : args->lastRow;
+        worker->args.band = args->band + started;
+        epicsEventSignal(worker->startEvent);
+    }
+
+    ADUVC_KernelArgs_t bandArgs = *args;
+    bandArgs.lastRow = args->firstRow + bandRows;
+    uvc_error_t status = convert(&bandArgs);
+
+    for (int i = 0; i < started; i++) {
+        epicsEventWait(this->workers[i].doneEvent);
+        if (status == UVC_SUCCESS) status = this->workers[i].status;
+    }
+    return status;
+}
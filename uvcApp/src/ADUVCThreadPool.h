@@ -0,0 +1,64 @@
+/*
+ * Header file for the ADUVC row band thread pool
+ *
+ * A small pool of persistent threads that splits the conversion of a single frame into bands of
+ * rows. The calling thread converts the first band itself and waits for the others, so frames are
+ * still handed on in the order they were received.
+ *
+ * Copyright (c) : 2018-2025 Brookhaven National Laboratory
+ *
+ */
+
+// header guard
+#ifndef ADUVC_THREAD_POOL_H
+#define ADUVC_THREAD_POOL_H
+
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <stddef.h>
+
+#include "ADUVCKernels.h"
+
+// Maximum number of threads, including the caller, that may convert one frame
+#define ADUVC_MAX_CONVERT_THREADS 16
+
+class ADUVCThreadPool {
+   public:
+    ADUVCThreadPool();
+    ~ADUVCThreadPool();
+
+    // Sets the number of threads converting a frame, including the calling thread
+    void setNumThreads(int numThreads);
+    int getNumThreads() const { return this->numWorkers + 1; }
+
+    // CPU time used by the worker threads since the pool was created, in microseconds. The
+    // calling thread's share is not included
+    size_t getCpuUs();
+
+    // Runs a kernel over the rows of args, split into bands of at least minBandRows rows
+    uvc_error_t run(ADUVC_KernelFunc_t convert, const ADUVC_KernelArgs_t* args,
+                    size_t minBandRows);
+
+   private:
+    /* State of a single worker thread. Only touched by the worker between its start and done
+     * events, and by the caller otherwise. */
+    typedef struct ADUVC_BAND_WORKER {
+        epicsThreadId thread;
+        epicsEventId startEvent;
+        epicsEventId doneEvent;
+        ADUVC_KernelFunc_t convert;
+        ADUVC_KernelArgs_t args;
+        uvc_error_t status;
+        bool exit;
+        size_t* pCpuUs;  // total of the pool the worker adds its CPU time to
+    } ADUVC_BandWorker_t;
+
+    ADUVC_BandWorker_t workers[ADUVC_MAX_CONVERT_THREADS - 1];
+    int numWorkers = 0;
+    size_t cpuUs = 0;
+
+    static void workerThreadC(void* pWorker);
+    void stopWorkers();
+};
+
+#endif
@@ -0,0 +1,372 @@
+/*
+ * Tests of the region, binning, orientation and statistics applied while converting frames
+ *
+ * A 4x3 Mono frame with the value 10 * y + x + 1 at column x and row y is placed with each
+ * transform, and the NDArray compared with the result worked out by hand:
+ *
+ *      1  2  3  4
+ *     11 12 13 14
+ *     21 22 23 24
+ *
+ * Copyright (c) : 2018-2025 Brookhaven National Laboratory
+ *
+ */
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ADUVCKernels.h"
+
+#define FRAME_WIDTH 4
+#define FRAME_HEIGHT 3
+
+static uint8_t frameData[FRAME_WIDTH * FRAME_HEIGHT];
+static ADUVC_PlaceBuffers_t placeBuffers[ADUVC_MAX_PLACE_BUFFERS];
+
+// Transform of the whole frame, without binning or reorientation
+static ADUVC_Transform_t identity() {
+    ADUVC_Transform_t transform;
+    memset(&transform, 0, sizeof(transform));
+    transform.binX = 1;
+    transform.binY = 1;
+    transform.binAverage = true;
+    transform.rotation = ADUVC_Rotate0;
+    return transform;
+}
+
+/*
+ * Places the test frame with a transform, and checks the size and pixels of the NDArray against
+ * the expected ones, given row by row. If pStats is set, the statistics of the frame are gathered
+ * into it.
+ */
+static void checkPlaced(const char* name, const ADUVC_Transform_t* pTransform, size_t outWidth,
+                        size_t outHeight, const uint8_t* expected, ADUVC_Geometry_t* pGeometry,
+                        ADUVC_Stats_t* pStats) {
+    const ADUVC_Kernel_t* pKernel =
+        ADUVC_findKernel(UVC_FRAME_FORMAT_GRAY8, NDUInt8, NDColorModeMono);
+    const ADUVC_Kernel_t* pRowKernel = ADUVC_findRowKernel(pKernel);
+
+    bool placed = ADUVC_setupGeometry(pGeometry, pKernel, pRowKernel, FRAME_WIDTH, FRAME_HEIGHT,
+                                      pTransform, pStats != NULL);
+    testOk(placed, "%s: rows are placed", name);
+    testOk(pGeometry->outWidth == outWidth && pGeometry->outHeight == outHeight,
+           "%s: NDArray is %dx%d, expected %dx%d", name, (int) pGeometry->outWidth,
+           (int) pGeometry->outHeight, (int) outWidth, (int) outHeight);
+    if (!placed || pGeometry->outWidth != outWidth || pGeometry->outHeight != outHeight) return;
+
+    uvc_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.data = frameData;
+    frame.data_bytes = sizeof(frameData);
+    frame.width = FRAME_WIDTH;
+    frame.height = FRAME_HEIGHT;
+    frame.step = FRAME_WIDTH;
+    frame.frame_format = UVC_FRAME_FORMAT_GRAY8;
+
+    uint8_t out[FRAME_WIDTH * FRAME_HEIGHT];
+    memset(out, 0xff, sizeof(out));
+    ADUVC_KernelArgs_t args;
+    memset(&args, 0, sizeof(args));
+    args.frame = &frame;
+    args.pOut = out;
+    args.outBytes = sizeof(out);
+    args.width = FRAME_WIDTH;
+    args.height = FRAME_HEIGHT;
+    args.inStep = FRAME_WIDTH;
+    args.firstRow = pGeometry->roiY;
+    args.lastRow = pGeometry->roiY + pGeometry->roiHeight;
+    args.decodeThreads = 1;
+    args.pGeometry = pGeometry;
+    args.pStats = pStats;
+    args.pPlaceBuffers = placeBuffers;
+    if (pStats != NULL) ADUVC_clearStats(pStats);
+
+    testOk(ADUVC_reservePlaceBuffers(placeBuffers, 1, pGeometry), "%s: buffers reserved", name);
+    testOk(ADUVC_convertPlaced(&args) == UVC_SUCCESS, "%s: frame converted", name);
+    bool same = memcmp(out, expected, outWidth * outHeight) == 0;
+    testOk(same, "%s: pixels placed", name);
+    if (!same) {
+        for (size_t y = 0; y < outHeight; y++) {
+            char line[64] = "";
+            for (size_t x = 0; x < outWidth; x++)
+                sprintf(line + strlen(line), " %3d", out[y * outWidth + x]);
+            testDiag("%s", line);
+        }
+    }
+}
+
+static void testOrientation() {
+    ADUVC_Geometry_t geometry;
+    ADUVC_Transform_t transform = identity();
+    transform.reverseX = true;
+    const uint8_t reverseX[] = {4, 3, 2, 1, 14, 13, 12, 11, 24, 23, 22, 21};
+    checkPlaced("ReverseX", &transform, 4, 3, reverseX, &geometry, NULL);
+
+    transform = identity();
+    transform.reverseY = true;
+    const uint8_t reverseY[] = {21, 22, 23, 24, 11, 12, 13, 14, 1, 2, 3, 4};
+    checkPlaced("ReverseY", &transform, 4, 3, reverseY, &geometry, NULL);
+
+    transform = identity();
+    transform.rotation = ADUVC_Rotate90;
+    const uint8_t rotate90[] = {21, 11, 1, 22, 12, 2, 23, 13, 3, 24, 14, 4};
+    checkPlaced("Rotate 90", &transform, 3, 4, rotate90, &geometry, NULL);
+    testOk1(geometry.transpose && geometry.reverseX && !geometry.reverseY);
+
+    transform = identity();
+    transform.rotation = ADUVC_Rotate180;
+    const uint8_t rotate180[] = {24, 23, 22, 21, 14, 13, 12, 11, 4, 3, 2, 1};
+    checkPlaced("Rotate 180", &transform, 4, 3, rotate180, &geometry, NULL);
+
+    transform = identity();
+    transform.rotation = ADUVC_Rotate270;
+    const uint8_t rotate270[] = {4, 14, 24, 3, 13, 23, 2, 12, 22, 1, 11, 21};
+    checkPlaced("Rotate 270", &transform, 3, 4, rotate270, &geometry, NULL);
+    testOk1(geometry.transpose && !geometry.reverseX && geometry.reverseY);
+
+    // mirrored first, then rotated: a transpose of the frame
+    transform = identity();
+    transform.reverseY = true;
+    transform.rotation = ADUVC_Rotate90;
+    const uint8_t transposed[] = {1, 11, 21, 2, 12, 22, 3, 13, 23, 4, 14, 24};
+    checkPlaced("ReverseY and rotate 90", &transform, 3, 4, transposed, &geometry, NULL);
+    testOk1(geometry.transpose && !geometry.reverseX && !geometry.reverseY);
+}
+
+static void testRegion() {
+    ADUVC_Geometry_t geometry;
+    ADUVC_Transform_t transform = identity();
+    transform.minX = 1;
+    transform.minY = 1;
+    transform.sizeX = 2;
+    transform.sizeY = 2;
+    const uint8_t region[] = {12, 13, 22, 23};
+    checkPlaced("Region", &transform, 2, 2, region, &geometry, NULL);
+
+    // a region running past the frame is clipped to it
+    transform = identity();
+    transform.minX = 2;
+    transform.sizeX = 10;
+    transform.sizeY = 10;
+    const uint8_t clipped[] = {3, 4, 13, 14, 23, 24};
+    checkPlaced("Region clipped", &transform, 2, 3, clipped, &geometry, NULL);
+
+    // one starting past the edge keeps the last column
+    transform = identity();
+    transform.minX = 10;
+    const uint8_t lastColumn[] = {4, 14, 24};
+    checkPlaced("Region past the edge", &transform, 1, 3, lastColumn, &geometry, NULL);
+    testOk1(geometry.roiX == 3);
+
+    transform = identity();
+    transform.minX = 1;
+    transform.sizeX = 2;
+    transform.sizeY = 2;
+    transform.rotation = ADUVC_Rotate90;
+    const uint8_t regionRotated[] = {12, 2, 13, 3};
+    checkPlaced("Region rotated", &transform, 2, 2, regionRotated, &geometry, NULL);
+}
+
+static void testBinning() {
+    ADUVC_Geometry_t geometry;
+    ADUVC_Transform_t transform = identity();
+    transform.binX = 2;
+    transform.binAverage = false;
+    const uint8_t sum2x1[] = {3, 7, 23, 27, 43, 47};
+    checkPlaced("Bin 2x1 sum", &transform, 2, 3, sum2x1, &geometry, NULL);
+
+    // the last row is left out, as it does not fill a bin
+    transform = identity();
+    transform.binX = 2;
+    transform.binY = 2;
+    transform.binAverage = false;
+    const uint8_t sum2x2[] = {26, 34};
+    checkPlaced("Bin 2x2 sum", &transform, 2, 1, sum2x2, &geometry, NULL);
+
+    // averages are rounded to the nearest value: 26 / 4 and 34 / 4
+    transform.binAverage = true;
+    const uint8_t average2x2[] = {7, 9};
+    checkPlaced("Bin 2x2 average", &transform, 2, 1, average2x2, &geometry, NULL);
+
+    // binning applies to the region, before the rotation
+    transform = identity();
+    transform.minY = 1;
+    transform.binX = 2;
+    transform.binY = 2;
+    transform.binAverage = false;
+    transform.rotation = ADUVC_Rotate90;
+    const uint8_t binnedRotated[] = {66, 74};
+    checkPlaced("Bin 2x2 of a region, rotated", &transform, 1, 2, binnedRotated, &geometry, NULL);
+
+    // a bin wider than the region is not applied
+    transform = identity();
+    transform.minX = 3;
+    transform.binX = 2;
+    const uint8_t unbinned[] = {4, 14, 24};
+    checkPlaced("Bin wider than the region", &transform, 1, 3, unbinned, &geometry, NULL);
+    testOk1(geometry.binX == 1);
+}
+
+static void testGeometry() {
+    const ADUVC_Kernel_t* pMono =
+        ADUVC_findKernel(UVC_FRAME_FORMAT_GRAY8, NDUInt8, NDColorModeMono);
+    const ADUVC_Kernel_t* pBayer =
+        ADUVC_findKernel(UVC_FRAME_FORMAT_SRGGB8, NDUInt8, NDColorModeBayer);
+    const ADUVC_Kernel_t* pYUV422 =
+        ADUVC_findKernel(UVC_FRAME_FORMAT_YUYV, NDUInt8, NDColorModeYUV422);
+    ADUVC_Geometry_t geometry;
+    ADUVC_Transform_t transform = identity();
+
+    testOk(!ADUVC_setupGeometry(&geometry, pMono, ADUVC_findRowKernel(pMono), 640, 480,
+                                &transform, false),
+           "Whole frame is written by the kernel itself");
+    testOk(ADUVC_setupGeometry(&geometry, pMono, ADUVC_findRowKernel(pMono), 640, 480, &transform,
+                               true),
+           "Whole frame is placed to gather statistics");
+
+    testOk(pYUV422 != NULL && ADUVC_findRowKernel(pYUV422) == NULL, "YUV422 has no row kernel");
+    transform.rotation = ADUVC_Rotate90;
+    testOk(!ADUVC_setupGeometry(&geometry, pYUV422, NULL, 640, 480, &transform, false),
+           "YUV422 output is not reoriented");
+
+    // raw Bayer output is never binned, as that would mix the colors of the mosaic
+    transform = identity();
+    transform.binX = 2;
+    transform.binY = 2;
+    testOk1(ADUVC_setupGeometry(&geometry, pBayer, ADUVC_findRowKernel(pBayer), 640, 480,
+                                &transform, false) == false);
+    testOk1(geometry.binX == 1 && geometry.binY == 1);
+    testOk1(geometry.outWidth == 640 && geometry.outHeight == 480);
+
+    // MJPEG regions start on a multiple of the bin height
+    const ADUVC_Kernel_t* pMJPEG =
+        ADUVC_findKernel(UVC_FRAME_FORMAT_MJPEG, NDUInt8, NDColorModeMono);
+    transform = identity();
+    transform.minY = 13;
+    transform.binY = 4;
+    testOk1(ADUVC_setupGeometry(&geometry, pMJPEG, ADUVC_findRowKernel(pMJPEG), 640, 480,
+                                &transform, false));
+    testOk(geometry.roiY == 12 && geometry.roiHeight == 468 && geometry.outHeight == 117,
+           "MJPEG region moved to row %d, %d rows, %d binned", (int) geometry.roiY,
+           (int) geometry.roiHeight, (int) geometry.outHeight);
+}
+
+static void testBayerPattern() {
+    ADUVC_Geometry_t geometry;
+    memset(&geometry, 0, sizeof(geometry));
+    geometry.outWidth = 4;
+    geometry.outHeight = 4;
+    testOk1(ADUVC_orientBayerPattern(NDBayerRGGB, &geometry) == NDBayerRGGB);
+
+    // a region starting on an odd column or row
+    geometry.roiX = 1;
+    testOk1(ADUVC_orientBayerPattern(NDBayerRGGB, &geometry) == NDBayerGRBG);
+    geometry.roiX = 0;
+    geometry.roiY = 1;
+    testOk1(ADUVC_orientBayerPattern(NDBayerRGGB, &geometry) == NDBayerGBRG);
+    geometry.roiY = 0;
+
+    // mirroring an even width swaps the columns of the tile, an odd width keeps them
+    geometry.reverseX = true;
+    testOk1(ADUVC_orientBayerPattern(NDBayerRGGB, &geometry) == NDBayerGRBG);
+    geometry.outWidth = 3;
+    testOk1(ADUVC_orientBayerPattern(NDBayerRGGB, &geometry) == NDBayerRGGB);
+    geometry.outWidth = 4;
+
+    // 180 degrees: both reversed
+    geometry.reverseY = true;
+    testOk1(ADUVC_orientBayerPattern(NDBayerRGGB, &geometry) == NDBayerBGGR);
+    testOk1(ADUVC_orientBayerPattern(NDBayerGBRG, &geometry) == NDBayerGRBG);
+
+    // 90 degrees clockwise: transposed, then reversed along X. RG/GB becomes GR/BG
+    geometry.transpose = true;
+    geometry.reverseX = true;
+    geometry.reverseY = false;
+    testOk1(ADUVC_orientBayerPattern(NDBayerRGGB, &geometry) == NDBayerGRBG);
+    testOk1(ADUVC_orientBayerPattern(NDBayerGRBG, &geometry) == NDBayerBGGR);
+
+    // 270 degrees clockwise: transposed, then reversed along Y. RG/GB becomes GB/RG
+    geometry.reverseX = false;
+    geometry.reverseY = true;
+    testOk1(ADUVC_orientBayerPattern(NDBayerRGGB, &geometry) == NDBayerGBRG);
+}
+
+static bool isNear(double value, double expected) {
+    return value > expected - 1e-9 && value < expected + 1e-9;
+}
+
+static void testStats() {
+    ADUVC_Geometry_t geometry;
+    ADUVC_Stats_t stats;
+    ADUVC_StatsResult_t result;
+
+    // two pixels of 10, at columns 0 and 2 of a single row
+    memset(&geometry, 0, sizeof(geometry));
+    geometry.outWidth = 3;
+    geometry.outHeight = 1;
+    ADUVC_clearStats(&stats);
+    stats.count = 3;
+    stats.sum = 20;
+    stats.min = 0;
+    stats.max = 10;
+    stats.sumX = 0 * 10 + 2 * 10;
+    stats.sumXX = 0 * 10 + 4 * 10;
+    ADUVC_finishStats(&stats, &geometry, &result);
+    testOk1(isNear(result.total, 20) && isNear(result.mean, 20.0 / 3));
+    testOk1(isNear(result.min, 0) && isNear(result.max, 10));
+    testOk1(isNear(result.centroidX, 1) && isNear(result.centroidY, 0));
+    testOk1(isNear(result.sigmaX, 1) && isNear(result.sigmaY, 0));
+
+    // the same row rotated by 90 degrees becomes a column
+    geometry.transpose = true;
+    geometry.reverseX = true;
+    geometry.outWidth = 1;
+    geometry.outHeight = 3;
+    ADUVC_finishStats(&stats, &geometry, &result);
+    testOk1(isNear(result.centroidX, 0) && isNear(result.centroidY, 1));
+    testOk1(isNear(result.sigmaX, 0) && isNear(result.sigmaY, 1));
+
+    // a frame without luma has no centroid
+    ADUVC_clearStats(&stats);
+    stats.count = 4;
+    stats.min = 0;
+    ADUVC_finishStats(&stats, &geometry, &result);
+    testOk1(isNear(result.mean, 0) && isNear(result.centroidX, 0) && isNear(result.sigmaY, 0));
+
+    // gathered while placing the test frame, whose values add up to 150
+    ADUVC_Transform_t transform = identity();
+    const uint8_t whole[] = {1, 2, 3, 4, 11, 12, 13, 14, 21, 22, 23, 24};
+    checkPlaced("Statistics", &transform, 4, 3, whole, &geometry, &stats);
+    ADUVC_finishStats(&stats, &geometry, &result);
+    testOk1(stats.count == 12 && stats.histogram[1] == 1 && stats.histogram[24] == 1);
+    testOk1(isNear(result.total, 150) && isNear(result.mean, 12.5));
+    testOk1(isNear(result.min, 1) && isNear(result.max, 24));
+    testOk(isNear(result.centroidX, 240.0 / 150) && isNear(result.centroidY, 230.0 / 150),
+           "Centroid %g, %g", result.centroidX, result.centroidY);
+
+    // and rotated by 90 degrees, where the columns hold 90, 50 and 10
+    transform.rotation = ADUVC_Rotate90;
+    const uint8_t rotate90[] = {21, 11, 1, 22, 12, 2, 23, 13, 3, 24, 14, 4};
+    checkPlaced("Statistics rotated", &transform, 3, 4, rotate90, &geometry, &stats);
+    ADUVC_finishStats(&stats, &geometry, &result);
+    testOk(isNear(result.centroidX, 70.0 / 150) && isNear(result.centroidY, 240.0 / 150),
+           "Rotated centroid %g, %g", result.centroidX, result.centroidY);
+}
+
+MAIN(ADUVCKernelsTest) {
+    testPlan(0);
+    for (int y = 0; y < FRAME_HEIGHT; y++)
+        for (int x = 0; x < FRAME_WIDTH; x++) frameData[y * FRAME_WIDTH + x] = 10 * y + x + 1;
+
+    testOrientation();
+    testRegion();
+    testBinning();
+    testGeometry();
+    testBayerPattern();
+    testStats();
+
+    ADUVC_freePlaceBuffers(placeBuffers, ADUVC_MAX_PLACE_BUFFERS);
+    return testDone();
+}
@@ -0,0 +1,140 @@
+/*
+ * Tests of the per-stage latency percentiles and histogram bins
+ *
+ * Copyright (c) : 2018-2025 Brookhaven National Laboratory
+ *
+ */
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+#include <string.h>
+
+#include "ADUVCLatency.h"
+
+// Latencies of a frame in microseconds, from the transfer onwards, 0 for a missing time point
+static ADUVC_FrameTimes_t frameTimes(uint64_t assemble, uint64_t handoff, uint64_t queue,
+                                     uint64_t decode, uint64_t publish) {
+    ADUVC_FrameTimes_t times;
+    uint64_t stages[] = {assemble, handoff, queue, decode, publish};
+    times.ns[ADUVC_TimeTransfer] = 1000000000ULL;
+    for (int point = ADUVC_TimeSwap; point < ADUVC_NUM_TIME_POINTS; point++)
+        times.ns[point] = times.ns[point - 1] + stages[point - 1] * 1000;
+    return times;
+}
+
+static bool isNear(double value, double expected) {
+    return value > expected - 1e-9 && value < expected + 1e-9;
+}
+
+// Each octave is split in four bins, 1 us in bin 0
+static void testBins(ADUVCLatency* pLatency) {
+    ADUVC_LatencySummary_t summary;
+    epicsInt32 histogram[ADUVC_LATENCY_BINS];
+    const struct {
+        uint64_t us;
+        int bin;
+    } bins[] = {{0, 0}, {1, 0}, {2, 4}, {3, 6}, {1000, 39}, {1024, 40}, {100000000, 95}};
+
+    for (size_t i = 0; i < sizeof(bins) / sizeof(bins[0]); i++) {
+        pLatency->reset();
+        ADUVC_FrameTimes_t times = frameTimes(bins[i].us, 0, 0, 0, 0);
+        pLatency->addFrame(&times);
+        pLatency->summarize(ADUVC_StageAssemble, &summary, histogram);
+        testOk(summary.numFrames == 1 && histogram[bins[i].bin] == 1, "%d us in bin %d",
+               (int) bins[i].us, bins[i].bin);
+    }
+}
+
+// Percentiles are taken by nearest rank
+static void testPercentiles(ADUVCLatency* pLatency) {
+    ADUVC_LatencySummary_t summary;
+    epicsInt32 histogram[ADUVC_LATENCY_BINS];
+
+    pLatency->reset();
+    pLatency->summarize(ADUVC_StageTotal, &summary, histogram);
+    testOk(summary.numFrames == 0 && summary.p50 == 0 && summary.max == 0, "Empty window");
+
+    // 1 to 100 ms of decoding, added out of order
+    for (int i = 0; i < 100; i++) {
+        ADUVC_FrameTimes_t times = frameTimes(10, 10, 10, (i * 37 % 100 + 1) * 1000, 10);
+        pLatency->addFrame(&times);
+    }
+    pLatency->summarize(ADUVC_StageDecode, &summary, histogram);
+    testOk(summary.numFrames == 100, "%d frames", summary.numFrames);
+    testOk(isNear(summary.p50, 50) && isNear(summary.p99, 99) && isNear(summary.max, 100),
+           "Decode p50 %g ms, p99 %g ms, max %g ms", summary.p50, summary.p99, summary.max);
+    pLatency->summarize(ADUVC_StageTotal, &summary, histogram);
+    testOk(isNear(summary.p50, 50.04) && isNear(summary.max, 100.04),
+           "Total p50 %g ms, max %g ms", summary.p50, summary.max);
+
+    int count = 0;
+    for (int bin = 0; bin < ADUVC_LATENCY_BINS; bin++) count += histogram[bin];
+    testOk(count == 100, "Histogram holds %d frames", count);
+
+    // a single frame is its own median and 99th percentile
+    pLatency->reset();
+    ADUVC_FrameTimes_t times = frameTimes(10, 10, 10, 7000, 10);
+    pLatency->addFrame(&times);
+    pLatency->summarize(ADUVC_StageDecode, &summary, histogram);
+    testOk1(isNear(summary.p50, 7) && isNear(summary.p99, 7) && isNear(summary.max, 7));
+}
+
+// Stages without both of their time points are left out
+static void testMissing(ADUVCLatency* pLatency) {
+    ADUVC_LatencySummary_t summary;
+    epicsInt32 histogram[ADUVC_LATENCY_BINS];
+
+    pLatency->reset();
+    for (int i = 0; i < 10; i++) {
+        ADUVC_FrameTimes_t times = frameTimes(100, 100, 100, 100, 100);
+        if (i % 2 == 0) times.ns[ADUVC_TimeAlloc] = 0;
+        pLatency->addFrame(&times);
+    }
+    pLatency->summarize(ADUVC_StageQueue, &summary, histogram);
+    testOk(summary.numFrames == 5, "Queue measured on %d frames", summary.numFrames);
+    pLatency->summarize(ADUVC_StageDecode, &summary, histogram);
+    testOk(summary.numFrames == 5, "Decode measured on %d frames", summary.numFrames);
+    pLatency->summarize(ADUVC_StageTotal, &summary, histogram);
+    testOk(summary.numFrames == 10, "Total measured on %d frames", summary.numFrames);
+
+    // a stage ending before it began, after a clock step, counts as 0
+    pLatency->reset();
+    ADUVC_FrameTimes_t times = frameTimes(100, 100, 100, 100, 100);
+    times.ns[ADUVC_TimeSwap] = times.ns[ADUVC_TimeTransfer] - 5000;
+    pLatency->addFrame(&times);
+    pLatency->summarize(ADUVC_StageAssemble, &summary, histogram);
+    testOk1(summary.numFrames == 1 && histogram[0] == 1 && summary.max == 0);
+}
+
+// Once full, the window keeps the most recent frames
+static void testWindow(ADUVCLatency* pLatency) {
+    ADUVC_LatencySummary_t summary;
+    epicsInt32 histogram[ADUVC_LATENCY_BINS];
+
+    pLatency->reset();
+    for (int i = 0; i < ADUVC_LATENCY_WINDOW; i++) {
+        ADUVC_FrameTimes_t times = frameTimes(10, 10, 10, 500000, 10);
+        pLatency->addFrame(&times);
+    }
+    for (int i = 0; i < ADUVC_LATENCY_WINDOW + 10; i++) {
+        ADUVC_FrameTimes_t times = frameTimes(10, 10, 10, 1000, 10);
+        pLatency->addFrame(&times);
+    }
+    pLatency->summarize(ADUVC_StageDecode, &summary, histogram);
+    testOk(summary.numFrames == ADUVC_LATENCY_WINDOW && isNear(summary.max, 1),
+           "%d frames in the window, max %g ms", summary.numFrames, summary.max);
+}
+
+MAIN(ADUVCLatencyTest) {
+    testPlan(0);
+    testOk1(strcmp(ADUVC_latencyStageName(ADUVC_StageTotal), "") != 0);
+
+    ADUVCLatency* pLatency = new ADUVCLatency();
+    testBins(pLatency);
+    testPercentiles(pLatency);
+    testMissing(pLatency);
+    testWindow(pLatency);
+    delete pLatency;
+
+    return testDone();
+}
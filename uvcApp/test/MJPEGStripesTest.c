@@ -0,0 +1,210 @@
+/*
+ * Tests of the restart interval parsing and striped decoding of MJPEG frames by libuvc
+ *
+ * Frames are encoded with libjpeg, with and without restart markers, and decoded row by row with
+ * the stripe pool of a device handle that is never opened. Striping must only happen when each
+ * restart interval is a whole number of MCU rows, every row must be passed once, and stripes must
+ * start on MCU row boundaries.
+ *
+ * Copyright (c) : 2018-2025 Brookhaven National Laboratory
+ *
+ */
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jpeglib.h>
+
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+#define MAX_WIDTH 128
+#define MAX_HEIGHT 128
+#define NUM_THREADS 4
+
+/* Rows passed to the row callback, and the stripe that decoded each */
+typedef struct DECODED_ROWS {
+    uint32_t x;
+    uint32_t width;
+    int components;
+    int count[MAX_HEIGHT];
+    int stripe[MAX_HEIGHT];
+    uint8_t pixels[MAX_HEIGHT * MAX_WIDTH * 3];
+} DecodedRows_t;
+
+static void rowCallback(uint32_t row, const uint8_t* scanline, int stripe, void* user_ptr) {
+    DecodedRows_t* pRows = (DecodedRows_t*) user_ptr;
+    if (row >= MAX_HEIGHT) return;
+    pRows->count[row]++;
+    pRows->stripe[row] = stripe;
+    memcpy(pRows->pixels + row * MAX_WIDTH * 3, scanline, pRows->width * pRows->components);
+}
+
+/*
+ * Encodes a test pattern. comps is 1 for greyscale or 3 for color with luma sampled hs by vs
+ * times the chroma. Restart markers are written every restartRows MCU rows, or every
+ * restartMCUs MCUs, none if both are 0.
+ */
+static uvc_frame_t* encodeFrame(int width, int height, int comps, int hs, int vs,
+                                int restartRows, int restartMCUs) {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char* pJPEG = NULL;
+    unsigned long jpegBytes = 0;
+    uvc_frame_t* pFrame;
+    JSAMPROW row;
+    int x, k;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &pJPEG, &jpegBytes);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = comps;
+    cinfo.in_color_space = comps == 3 ? JCS_RGB : JCS_GRAYSCALE;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 90, TRUE);
+    if (comps == 3) {
+        cinfo.comp_info[0].h_samp_factor = hs;
+        cinfo.comp_info[0].v_samp_factor = vs;
+    }
+    cinfo.restart_in_rows = restartRows;
+    cinfo.restart_interval = restartMCUs;
+    jpeg_start_compress(&cinfo, TRUE);
+
+    row = (JSAMPROW) malloc(width * comps);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        int y = cinfo.next_scanline;
+        for (x = 0; x < width; x++)
+            for (k = 0; k < comps; k++) row[x * comps + k] = (uint8_t) (x * 2 + y * (k + 1) * 3);
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    free(row);
+
+    pFrame = uvc_allocate_frame(jpegBytes);
+    memcpy(pFrame->data, pJPEG, jpegBytes);
+    pFrame->data_bytes = jpegBytes;
+    pFrame->width = width;
+    pFrame->height = height;
+    pFrame->frame_format = UVC_FRAME_FORMAT_MJPEG;
+    free(pJPEG);
+    return pFrame;
+}
+
+/*
+ * Decodes a region of a frame row by row, and checks that each of its rows is passed once and
+ * that stripes start on a multiple of mcuHeight rows. If compare is set, the pixels must also be
+ * those of the frame decoded by libuvc on a single thread.
+ *
+ * @return: number of stripes the rows were decoded by
+ */
+static int checkStripes(const char* name, uvc_frame_t* pFrame, int comps, uint32_t x, uint32_t y,
+                        uint32_t width, uint32_t height, uint32_t mcuHeight, int compare) {
+    static DecodedRows_t rows;
+    enum uvc_frame_format format = comps == 3 ? UVC_FRAME_FORMAT_RGB : UVC_FRAME_FORMAT_GRAY8;
+    int numStripes = 0, once = 1, aligned = 1, same = 1;
+    uint32_t row;
+
+    memset(&rows, 0, sizeof(rows));
+    rows.x = x;
+    rows.width = width;
+    rows.components = comps;
+    testOk(uvc_mjpeg_decode_region(pFrame, format, NUM_THREADS, x, y, width, height, rowCallback,
+                                   &rows) == UVC_SUCCESS,
+           "%s: decoded", name);
+
+    for (row = 0; row < pFrame->height; row++) {
+        int inRegion = row >= y && row < y + height;
+        if (rows.count[row] != (inRegion ? 1 : 0)) once = 0;
+        if (!inRegion) continue;
+        if (rows.stripe[row] + 1 > numStripes) numStripes = rows.stripe[row] + 1;
+        if (row > y && rows.stripe[row] != rows.stripe[row - 1] && row % mcuHeight != 0)
+            aligned = 0;
+    }
+    testOk(once, "%s: each row of the region passed once", name);
+    testOk(aligned, "%s: stripes start on a multiple of %u rows", name, mcuHeight);
+
+    if (compare) {
+        uvc_frame_t* pFull = uvc_allocate_frame(pFrame->width * pFrame->height * comps);
+        uvc_error_t status =
+            comps == 3 ? uvc_mjpeg2rgb(pFrame, pFull) : uvc_mjpeg2gray(pFrame, pFull);
+        for (row = y; row < y + height && status == UVC_SUCCESS; row++) {
+            const uint8_t* pExpected = (const uint8_t*) pFull->data + row * pFull->step + x * comps;
+            if (memcmp(rows.pixels + row * MAX_WIDTH * 3, pExpected, width * comps) != 0) same = 0;
+        }
+        testOk(status == UVC_SUCCESS && same, "%s: pixels match the single threaded decode", name);
+        uvc_free_frame(pFull);
+    }
+    return numStripes;
+}
+
+MAIN(MJPEGStripesTest) {
+    uvc_device_handle_t* pDevh = (uvc_device_handle_t*) calloc(1, sizeof(uvc_device_handle_t));
+    uvc_frame_t* pFrame;
+    int numStripes;
+
+    testPlan(0);
+    pDevh->mjpeg_pool = _uvc_mjpeg_pool_create(pDevh);
+
+    /* a restart marker every MCU row */
+    pFrame = encodeFrame(64, 64, 1, 1, 1, 1, 0);
+    numStripes = checkStripes("Gray, no device", pFrame, 1, 0, 0, 64, 64, 8, 1);
+    testOk(numStripes == 1, "Frame without a device decoded by %d stripe(s)", numStripes);
+    pFrame->source = pDevh;
+    numStripes = checkStripes("Gray", pFrame, 1, 0, 0, 64, 64, 8, 1);
+    testOk(numStripes == NUM_THREADS, "Gray frame decoded by %d stripe(s)", numStripes);
+    numStripes = checkStripes("Gray region", pFrame, 1, 8, 20, 16, 24, 8, 1);
+    testOk(numStripes > 1, "Region decoded by %d stripe(s)", numStripes);
+    uvc_free_frame(pFrame);
+
+    pFrame = encodeFrame(64, 48, 3, 1, 1, 1, 0);
+    pFrame->source = pDevh;
+    numStripes = checkStripes("4:4:4", pFrame, 3, 0, 0, 64, 48, 8, 1);
+    testOk(numStripes == NUM_THREADS, "4:4:4 frame decoded by %d stripe(s)", numStripes);
+    numStripes = checkStripes("4:4:4 region", pFrame, 3, 5, 9, 30, 30, 8, 1);
+    testOk(numStripes > 1, "4:4:4 region decoded by %d stripe(s)", numStripes);
+    uvc_free_frame(pFrame);
+
+    /* 16 row MCUs, whose chroma is not smoothed across stripes, so only the rows are checked */
+    pFrame = encodeFrame(96, 128, 3, 2, 2, 1, 0);
+    pFrame->source = pDevh;
+    numStripes = checkStripes("4:2:0", pFrame, 3, 0, 0, 96, 128, 16, 0);
+    testOk(numStripes == NUM_THREADS, "4:2:0 frame decoded by %d stripe(s)", numStripes);
+    uvc_free_frame(pFrame);
+
+    /* two MCU rows per restart interval */
+    pFrame = encodeFrame(64, 64, 1, 1, 1, 2, 0);
+    pFrame->source = pDevh;
+    numStripes = checkStripes("Gray, 2 rows per interval", pFrame, 1, 0, 0, 64, 64, 16, 1);
+    testOk(numStripes == NUM_THREADS, "Decoded by %d stripes", numStripes);
+    uvc_free_frame(pFrame);
+
+    /* frames that cannot be split are decoded by the calling thread alone */
+    pFrame = encodeFrame(64, 64, 1, 1, 1, 0, 0);
+    pFrame->source = pDevh;
+    numStripes = checkStripes("No restart markers", pFrame, 1, 0, 0, 64, 64, 8, 1);
+    testOk(numStripes == 1, "Frame without restart markers decoded by %d stripe(s)", numStripes);
+    uvc_free_frame(pFrame);
+
+    pFrame = encodeFrame(64, 64, 1, 1, 1, 0, 3);
+    pFrame->source = pDevh;
+    numStripes = checkStripes("Partial MCU rows", pFrame, 1, 0, 0, 64, 64, 8, 1);
+    testOk(numStripes == 1, "Interval of 3 of the 8 MCUs in a row decoded by %d stripe(s)",
+           numStripes);
+    uvc_free_frame(pFrame);
+
+    /* a single MCU row per interval and fewer intervals than threads */
+    pFrame = encodeFrame(64, 16, 1, 1, 1, 1, 0);
+    pFrame->source = pDevh;
+    numStripes = checkStripes("Two intervals", pFrame, 1, 0, 0, 64, 16, 8, 1);
+    testOk(numStripes == 2, "Frame of two intervals decoded by %d stripe(s)", numStripes);
+    uvc_free_frame(pFrame);
+
+    _uvc_mjpeg_pool_destroy(pDevh->mjpeg_pool);
+    free(pDevh);
+    return testDone();
+}
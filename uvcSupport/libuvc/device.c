@@ -349,6 +349,9 @@ static uvc_error_t uvc_open_internal(
   internal_devh = calloc(1, sizeof(*internal_devh));
   internal_devh->dev = dev;
   internal_devh->usb_devh = usb_devh;
+#ifdef LIBUVC_HAS_JPEG
+  internal_devh->mjpeg_pool = _uvc_mjpeg_pool_create(internal_devh);
+#endif
 
   ret = uvc_get_device_info(internal_devh, &(internal_devh->info));
 
@@ -1706,6 +1709,10 @@ void uvc_free_devh(uvc_device_handle_t *devh) {
   if (devh->status_xfer)
     libusb_free_transfer(devh->status_xfer);
 
+#ifdef LIBUVC_HAS_JPEG
+  _uvc_mjpeg_pool_destroy(devh->mjpeg_pool);
+#endif
+
   free(devh);
 
   UVC_EXIT_VOID();
@@ -122,7 +122,184 @@ static void insert_huff_tables(j_decompress_ptr dinfo) {
   COPY_HUFF_TABLE(dinfo, ac_huff_tbl_ptrs[1], ac_chromi);
 }
 
-static uvc_error_t uvc_mjpeg_convert(uvc_frame_t *in, uvc_frame_t *out) {
+/** @internal
+ * @brief Check whether a Y'CbCr JPEG can be read as raw component planes
+ *
+ * Raw planes are used for the common 4:4:4, 4:2:2 and 4:2:0 layouts, where each chroma
+ * sample covers at most two luma samples in either direction.
+ */
+static boolean _uvc_mjpeg_can_read_raw(j_decompress_ptr dinfo) {
+  if (dinfo->num_components != 3 || dinfo->jpeg_color_space != JCS_YCbCr)
+    return FALSE;
+
+  if (dinfo->comp_info[1].h_samp_factor != 1 || dinfo->comp_info[1].v_samp_factor != 1 ||
+      dinfo->comp_info[2].h_samp_factor != 1 || dinfo->comp_info[2].v_samp_factor != 1)
+    return FALSE;
+
+  return dinfo->comp_info[0].h_samp_factor <= 2 && dinfo->comp_info[0].v_samp_factor <= 2;
+}
+
+/** @internal
+ * @brief Read a started decompression as packed UYVY
+ *
+ * With raw_data_out set, luma and chroma are read as planes at their coded resolution
+ * and interleaved here, skipping libjpeg's chroma upsampling and colour conversion.
+ * Otherwise full-resolution Y'CbCr (or grayscale) scanlines are read and subsampled.
+ * Buffers come from the JPOOL_IMAGE pool so that an error longjmp cannot leak them.
+ */
+static void _uvc_mjpeg_read_uyvy(j_decompress_ptr dinfo, uint8_t *dst, size_t step) {
+  JDIMENSION width = dinfo->output_width;
+  JDIMENSION x;
+
+  if (dinfo->raw_data_out) {
+    JSAMPARRAY planes[3];
+    int v_luma = dinfo->comp_info[0].v_samp_factor;
+    int h_shift = dinfo->comp_info[0].h_samp_factor - 1;
+    int rows_per_read = dinfo->max_v_samp_factor * DCTSIZE;
+    int c;
+
+    for (c = 0; c < 3; c++) {
+      jpeg_component_info *comp = &dinfo->comp_info[c];
+      planes[c] = (*dinfo->mem->alloc_sarray)((j_common_ptr) dinfo, JPOOL_IMAGE,
+          comp->width_in_blocks * DCTSIZE, comp->v_samp_factor * DCTSIZE);
+    }
+
+    while (dinfo->output_scanline < dinfo->output_height) {
+      JDIMENSION first = dinfo->output_scanline;
+      JDIMENSION rows = jpeg_read_raw_data(dinfo, planes, rows_per_read);
+      JDIMENSION r;
+
+      for (r = 0; r < rows && first + r < dinfo->output_height; r++) {
+        const JSAMPLE *py = planes[0][r];
+        const JSAMPLE *pu = planes[1][r / v_luma];
+        const JSAMPLE *pv = planes[2][r / v_luma];
+        uint8_t *puyvy = dst + (first + r) * step;
+
+        for (x = 0; x + 1 < width; x += 2) {
+          puyvy[0] = pu[x >> h_shift];
+          puyvy[1] = py[x];
+          puyvy[2] = pv[x >> h_shift];
+          puyvy[3] = py[x + 1];
+          puyvy += 4;
+        }
+        if (x < width) {
+          /* odd width: the last pixel has no partner to share its chroma with */
+          puyvy[0] = pu[x >> h_shift];
+          puyvy[1] = py[x];
+        }
+      }
+    }
+  } else {
+    int components = dinfo->output_components;
+    JSAMPARRAY line = (*dinfo->mem->alloc_sarray)((j_common_ptr) dinfo, JPOOL_IMAGE,
+        width * components, 1);
+
+    while (dinfo->output_scanline < dinfo->output_height) {
+      uint8_t *puyvy = dst + dinfo->output_scanline * step;
+      const JSAMPLE *p = line[0];
+
+      jpeg_read_scanlines(dinfo, line, 1);
+
+      for (x = 0; x < width; x += 2) {
+        int last = (x + 1 == width);
+
+        if (components == 1) {
+          puyvy[0] = 128;
+          puyvy[1] = p[0];
+          if (!last) {
+            puyvy[2] = 128;
+            puyvy[3] = p[1];
+          }
+        } else {
+          puyvy[0] = p[1];
+          puyvy[1] = p[0];
+          if (!last) {
+            puyvy[2] = p[2];
+            puyvy[3] = p[3];
+          }
+        }
+        p += 2 * components;
+        puyvy += 4;
+      }
+    }
+  }
+}
+
+/** @internal
+ * @brief Region of a frame passed scanline by scanline to a row callback
+ */
+struct _uvc_mjpeg_rows {
+  uvc_mjpeg_row_callback_t *cb;
+  void *user_ptr;
+  /** Stripe index reported to cb */
+  int stripe;
+  /** Expected width of the bitstream */
+  uint32_t frame_width;
+  /** Frame row of the first scanline of the bitstream */
+  uint32_t first_row;
+  /** Columns and frame rows passed to cb */
+  uint32_t x, width, y, height;
+};
+
+/** @internal
+ * @brief Pass the scanlines of a decompressor's region to its row callback
+ *
+ * With libjpeg-turbo only the iMCU columns covering the region are decoded, and the
+ * rows above it are skipped without color conversion or upsampling. The rows below
+ * the region are never read.
+ */
+static void _uvc_mjpeg_read_rows(j_decompress_ptr dinfo, const struct _uvc_mjpeg_rows *rows) {
+  JDIMENSION xoffset = 0, width = dinfo->output_width;
+  JDIMENSION skip = rows->y > rows->first_row ? rows->y - rows->first_row : 0;
+  JDIMENSION end = rows->y + rows->height - rows->first_row;
+  JSAMPARRAY line;
+
+  if (end > dinfo->output_height)
+    end = dinfo->output_height;
+
+#ifdef LIBJPEG_TURBO_VERSION
+  if (rows->width < dinfo->output_width) {
+    /* one more column on each side, so that smoothed chroma upsampling sees the
+     * same neighbours as when decoding the full width */
+    xoffset = rows->x > 0 ? rows->x - 1 : 0;
+    width = rows->x + rows->width + 1 - xoffset;
+    if (xoffset + width > dinfo->output_width)
+      width = dinfo->output_width - xoffset;
+    jpeg_crop_scanline(dinfo, &xoffset, &width);
+  }
+  if (skip > 0)
+    jpeg_skip_scanlines(dinfo, skip);
+#endif
+
+  line = (*dinfo->mem->alloc_sarray)((j_common_ptr) dinfo, JPOOL_IMAGE,
+      dinfo->output_width * dinfo->output_components, 1);
+
+  while (dinfo->output_scanline < end) {
+    uint32_t row = rows->first_row + dinfo->output_scanline;
+
+    jpeg_read_scanlines(dinfo, line, 1);
+    if (row >= rows->y)
+      rows->cb(row, line[0] + (rows->x - xoffset) * dinfo->output_components, rows->stripe,
+               rows->user_ptr);
+  }
+}
+
+/** @internal
+ * @brief Decode a JPEG bitstream into a caller-supplied buffer
+ *
+ * @param data JPEG bitstream
+ * @param data_bytes Length of the bitstream
+ * @param format Output format, UVC_FRAME_FORMAT_RGB, UVC_FRAME_FORMAT_GRAY8 or
+ *               UVC_FRAME_FORMAT_UYVY
+ * @param dst First output scanline, unused when rows is set
+ * @param step Number of bytes between output scanlines
+ * @param fancy_upsampling Whether to use libjpeg's smoothed chroma upsampling
+ * @param rows If set, the RGB or GRAY8 scanlines of this region are passed to its
+ *             row callback instead
+ */
+static uvc_error_t _uvc_mjpeg_decode(const uint8_t *data, size_t data_bytes,
+    enum uvc_frame_format format, uint8_t *dst, size_t step, int fancy_upsampling,
+    const struct _uvc_mjpeg_rows *rows) {
   struct jpeg_decompress_struct dinfo;
   struct error_mgr jerr;
   size_t lines_read;
@@ -134,7 +311,7 @@ static uvc_error_t uvc_mjpeg_convert(uvc_frame_t *in, uvc_frame_t *out) {
   }
 
   jpeg_create_decompress(&dinfo);
-  jpeg_mem_src(&dinfo, in->data, in->data_bytes);
+  jpeg_mem_src(&dinfo, (unsigned char *) data, data_bytes);
   jpeg_read_header(&dinfo, TRUE);
 
   if (dinfo.dc_huff_tbl_ptrs[0] == NULL) {
@@ -142,27 +319,43 @@ static uvc_error_t uvc_mjpeg_convert(uvc_frame_t *in, uvc_frame_t *out) {
     insert_huff_tables(&dinfo);
   }
 
-  if (out->frame_format == UVC_FRAME_FORMAT_RGB)
+  if (format == UVC_FRAME_FORMAT_RGB)
     dinfo.out_color_space = JCS_RGB;
-  else if (out->frame_format == UVC_FRAME_FORMAT_GRAY8)
+  else if (format == UVC_FRAME_FORMAT_GRAY8)
     dinfo.out_color_space = JCS_GRAYSCALE;
-  else
+  else if (format == UVC_FRAME_FORMAT_UYVY) {
+    dinfo.out_color_space = dinfo.num_components == 1 ? JCS_GRAYSCALE : JCS_YCbCr;
+    dinfo.raw_data_out = _uvc_mjpeg_can_read_raw(&dinfo);
+  } else
     goto fail;
 
   dinfo.dct_method = JDCT_IFAST;
+  dinfo.do_fancy_upsampling = fancy_upsampling ? TRUE : FALSE;
 
   jpeg_start_decompress(&dinfo);
 
-  lines_read = 0;
-  while (dinfo.output_scanline < dinfo.output_height) {
-    unsigned char *buffer[1] = {( unsigned char*) out->data + lines_read * out->step };
-    int num_scanlines;
+  if (format == UVC_FRAME_FORMAT_UYVY) {
+    _uvc_mjpeg_read_uyvy(&dinfo, dst, step);
+  } else if (rows) {
+    if (dinfo.output_width != rows->frame_width)
+      goto fail;
 
-    num_scanlines = jpeg_read_scanlines(&dinfo, buffer, 1);
-    lines_read += num_scanlines;
+    _uvc_mjpeg_read_rows(&dinfo, rows);
+  } else {
+    lines_read = 0;
+    while (dinfo.output_scanline < dinfo.output_height) {
+      unsigned char *buffer[1] = {( unsigned char*) dst + lines_read * step };
+      int num_scanlines;
+
+      num_scanlines = jpeg_read_scanlines(&dinfo, buffer, 1);
+      lines_read += num_scanlines;
+    }
   }
 
-  jpeg_finish_decompress(&dinfo);
+  if (dinfo.output_scanline < dinfo.output_height)
+    jpeg_abort_decompress(&dinfo);
+  else
+    jpeg_finish_decompress(&dinfo);
   jpeg_destroy_decompress(&dinfo);
   return 0;
 
@@ -171,6 +364,607 @@ fail:
   return UVC_ERROR_OTHER;
 }
 
+static uvc_error_t uvc_mjpeg_convert(uvc_frame_t *in, uvc_frame_t *out) {
+  uvc_error_t ret;
+
+  UVC_PROBE3(mjpeg_decode_start, in->sequence, in->data_bytes, 1);
+  ret = _uvc_mjpeg_decode(in->data, in->data_bytes, out->frame_format,
+                          out->data, out->step, 1, NULL);
+  UVC_PROBE3(mjpeg_decode_done, in->sequence, 1, ret);
+  return ret;
+}
+
+/* Upper bound on the number of stripes a frame is split into for parallel decoding */
+#define UVC_MJPEG_MAX_STRIPES 16
+
+#define BE16(p) (((p)[0] << 8) | (p)[1])
+
+/** @internal
+ * @brief Layout of a baseline JPEG that uses restart intervals
+ */
+struct _uvc_mjpeg_layout {
+  /** Offset of the SOF marker, needed to patch in the stripe height */
+  size_t sof_offset;
+  /** Offset of the first entropy-coded byte, i.e. length of the header */
+  size_t scan_offset;
+  uint16_t width, height;
+  /** Height of one MCU row in pixels */
+  uint16_t mcu_height;
+  /** Whether any component is vertically subsampled */
+  uint8_t vsub;
+  /** Number of MCU rows between restart markers */
+  uint32_t rows_per_interval;
+  /** Number of restart intervals in the scan */
+  uint32_t num_intervals;
+  /** Start (inclusive) and end (exclusive) offset of each interval's entropy-coded data */
+  size_t *interval_start;
+  size_t *interval_end;
+};
+
+/** @internal
+ * @brief A horizontal band of scanlines decoded from its own restart intervals
+ */
+struct _uvc_mjpeg_stripe {
+  /** Stand-alone JPEG made up of the frame's header and this stripe's intervals */
+  uint8_t *jpeg;
+  size_t jpeg_bytes;
+  enum uvc_frame_format format;
+  uint8_t *dst;
+  size_t step;
+  int fancy_upsampling;
+  struct _uvc_mjpeg_rows rows;
+  uvc_error_t result;
+};
+
+/** @internal
+ * @brief A thread of a stripe pool, which always decodes the stripe with its index
+ */
+struct _uvc_mjpeg_worker {
+  struct uvc_mjpeg_pool *pool;
+  pthread_t thread;
+  /** Stripe decoded by the worker, from 1 as the caller decodes stripe 0 */
+  uint32_t index;
+  /** Generation of the pool when the worker was started */
+  uint32_t generation;
+};
+
+/** @internal
+ * @brief Threads and buffers decoding the stripes of a device's MJPEG frames
+ *
+ * Workers are started the first time a frame is split into that many stripes, and
+ * kept until the device is closed. Stripe JPEGs and the restart interval offsets
+ * are built into buffers that only grow, so once the pool has seen a frame of a
+ * given size, its frames are decoded without starting threads or allocating.
+ */
+struct uvc_mjpeg_pool {
+  uvc_device_handle_t *devh;
+  /** Held while a frame is decoded, so frames of a device are decoded one at a time */
+  pthread_mutex_t decode_mutex;
+  /** Protects the fields below, waited on by the workers */
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+  /** Incremented each time the stripes of a frame are handed to the workers */
+  uint32_t generation;
+  struct _uvc_mjpeg_stripe *stripes;
+  uint32_t num_stripes;
+  /** Workers still decoding their stripe of the current frame */
+  uint32_t pending;
+  int kill;
+  struct _uvc_mjpeg_worker workers[UVC_MJPEG_MAX_STRIPES - 1];
+  uint32_t num_workers;
+  /** Stripe JPEGs, and the bytes allocated for each */
+  uint8_t *jpeg[UVC_MJPEG_MAX_STRIPES];
+  size_t jpeg_capacity[UVC_MJPEG_MAX_STRIPES];
+  /** Restart interval offsets, and the number of intervals allocated */
+  size_t *interval_start;
+  size_t *interval_end;
+  uint32_t interval_capacity;
+};
+
+/** @internal
+ * @brief Locate the restart intervals of a JPEG bitstream
+ *
+ * Striping is only possible for single-scan sequential JPEGs whose restart interval
+ * is a whole number of MCU rows, as every restart marker then begins a new stripe
+ * of scanlines that can be decoded without any state from the previous ones. The
+ * interval offsets are stored in the buffers of pool, which layout then points to.
+ *
+ * @return 1 if the frame can be split into stripes, 0 otherwise
+ */
+static int _uvc_mjpeg_parse_layout(const uint8_t *data, size_t len,
+    struct _uvc_mjpeg_layout *layout, struct uvc_mjpeg_pool *pool) {
+  size_t pos = 2;
+  uint32_t restart_interval = 0;
+  uint8_t num_components = 0, h_max = 1, v_max = 1;
+  uint32_t mcus_per_row, mcu_rows, mcu_width, expected, capacity;
+  size_t i;
+  int c;
+
+  memset(layout, 0, sizeof(*layout));
+
+  if (len < 4 || data[0] != 0xff || data[1] != 0xd8)
+    return 0;
+
+  /* walk the marker segments up to and including the start of scan */
+  while (!layout->scan_offset) {
+    uint8_t marker;
+    size_t seg_len;
+
+    if (pos + 4 > len || data[pos] != 0xff)
+      return 0;
+
+    marker = data[pos + 1];
+    if (marker == 0xff) {
+      /* fill byte */
+      pos++;
+      continue;
+    }
+
+    seg_len = BE16(data + pos + 2);
+    if (seg_len < 2 || pos + 2 + seg_len > len)
+      return 0;
+
+    switch (marker) {
+    case 0xc0: /* baseline */
+    case 0xc1: /* extended sequential, Huffman */
+      if (seg_len < 8)
+        return 0;
+      layout->sof_offset = pos;
+      layout->height = BE16(data + pos + 5);
+      layout->width = BE16(data + pos + 7);
+      num_components = data[pos + 9];
+      if (num_components == 0 || seg_len < 8 + 3 * (size_t) num_components)
+        return 0;
+      for (c = 0; c < num_components; c++) {
+        uint8_t sampling = data[pos + 11 + 3 * c];
+        if ((sampling >> 4) > h_max)
+          h_max = sampling >> 4;
+        if ((sampling & 0x0f) > v_max)
+          v_max = sampling & 0x0f;
+      }
+      break;
+    case 0xc2: case 0xc3: case 0xc5: case 0xc6: case 0xc7:
+    case 0xc9: case 0xca: case 0xcb: case 0xcd: case 0xce: case 0xcf:
+      /* progressive, lossless, hierarchical and arithmetic coded frames */
+      return 0;
+    case 0xdd:
+      if (seg_len < 4)
+        return 0;
+      restart_interval = BE16(data + pos + 4);
+      break;
+    case 0xda:
+      /* the whole image must be coded in this one interleaved scan */
+      if (!layout->sof_offset || data[pos + 4] != num_components)
+        return 0;
+      layout->scan_offset = pos + 2 + seg_len;
+      break;
+    case 0xd9:
+      return 0;
+    }
+
+    pos += 2 + seg_len;
+  }
+
+  if (restart_interval == 0 || layout->width == 0 || layout->height == 0)
+    return 0;
+
+  /* a single-component scan is not interleaved, so its MCU is a single block */
+  if (num_components == 1)
+    h_max = v_max = 1;
+
+  mcu_width = 8 * h_max;
+  layout->mcu_height = 8 * v_max;
+  layout->vsub = v_max > 1;
+  mcus_per_row = (layout->width + mcu_width - 1) / mcu_width;
+  mcu_rows = (layout->height + layout->mcu_height - 1) / layout->mcu_height;
+
+  if (restart_interval % mcus_per_row != 0)
+    return 0;
+
+  layout->rows_per_interval = restart_interval / mcus_per_row;
+  expected = (mcu_rows + layout->rows_per_interval - 1) / layout->rows_per_interval;
+  if (expected < 2)
+    return 0;
+
+  if (expected > pool->interval_capacity) {
+    size_t *start = realloc(pool->interval_start, expected * sizeof(size_t));
+    size_t *end;
+
+    if (!start)
+      return 0;
+    pool->interval_start = start;
+    end = realloc(pool->interval_end, expected * sizeof(size_t));
+    if (!end)
+      return 0;
+    pool->interval_end = end;
+    pool->interval_capacity = expected;
+  }
+  capacity = expected;
+  layout->interval_start = pool->interval_start;
+  layout->interval_end = pool->interval_end;
+
+  /* find the RSTn markers that separate the intervals, skipping stuffed bytes */
+  layout->interval_start[0] = layout->scan_offset;
+  layout->num_intervals = 1;
+  for (i = layout->scan_offset; i + 1 < len; i++) {
+    uint8_t next;
+
+    if (data[i] != 0xff)
+      continue;
+
+    next = data[i + 1];
+    if (next == 0x00 || next == 0xff)
+      continue;
+
+    if (next >= 0xd0 && next <= 0xd7) {
+      if (layout->num_intervals == capacity)
+        return 0;
+      layout->interval_end[layout->num_intervals - 1] = i;
+      layout->interval_start[layout->num_intervals] = i + 2;
+      layout->num_intervals++;
+      i++;
+      continue;
+    }
+
+    /* EOI or any other marker ends the scan */
+    break;
+  }
+  layout->interval_end[layout->num_intervals - 1] = i;
+
+  return layout->num_intervals == expected;
+}
+
+static void _uvc_mjpeg_decode_stripe(struct _uvc_mjpeg_stripe *stripe) {
+  stripe->result = _uvc_mjpeg_decode(stripe->jpeg, stripe->jpeg_bytes, stripe->format,
+                                     stripe->dst, stripe->step, stripe->fancy_upsampling,
+                                     stripe->rows.cb ? &stripe->rows : NULL);
+}
+
+static void *_uvc_mjpeg_pool_worker(void *arg) {
+  struct _uvc_mjpeg_worker *worker = (struct _uvc_mjpeg_worker *) arg;
+  struct uvc_mjpeg_pool *pool = worker->pool;
+  uint32_t generation = worker->generation;
+  uint64_t last_cpu_ns = _uvc_thread_cpu_ns(), cpu_ns;
+
+  pthread_mutex_lock(&pool->mutex);
+  for (;;) {
+    while (pool->generation == generation && !pool->kill)
+      pthread_cond_wait(&pool->work_cond, &pool->mutex);
+    if (pool->kill)
+      break;
+
+    generation = pool->generation;
+    if (worker->index >= pool->num_stripes)
+      continue;
+
+    pthread_mutex_unlock(&pool->mutex);
+    _uvc_mjpeg_decode_stripe(&pool->stripes[worker->index]);
+    cpu_ns = _uvc_thread_cpu_ns();
+    __atomic_fetch_add(&pool->devh->decode_cpu_ns, cpu_ns - last_cpu_ns, __ATOMIC_RELAXED);
+    last_cpu_ns = cpu_ns;
+    pthread_mutex_lock(&pool->mutex);
+
+    if (--pool->pending == 0)
+      pthread_cond_signal(&pool->done_cond);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+/** @internal
+ * @brief Create the stripe pool of a device, without starting any thread
+ */
+struct uvc_mjpeg_pool *_uvc_mjpeg_pool_create(uvc_device_handle_t *devh) {
+  struct uvc_mjpeg_pool *pool = calloc(1, sizeof(*pool));
+
+  if (!pool)
+    return NULL;
+
+  pool->devh = devh;
+  pthread_mutex_init(&pool->decode_mutex, NULL);
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->work_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+
+  return pool;
+}
+
+/** @internal
+ * @brief Stop the workers of a stripe pool and free it
+ *
+ * No frame of the device may be being decoded.
+ */
+void _uvc_mjpeg_pool_destroy(struct uvc_mjpeg_pool *pool) {
+  uint32_t i;
+
+  if (!pool)
+    return;
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->kill = 1;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (i = 0; i < pool->num_workers; i++)
+    pthread_join(pool->workers[i].thread, NULL);
+
+  for (i = 0; i < UVC_MJPEG_MAX_STRIPES; i++)
+    free(pool->jpeg[i]);
+  free(pool->interval_start);
+  free(pool->interval_end);
+
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_mutex_destroy(&pool->decode_mutex);
+  free(pool);
+}
+
+/** @internal
+ * @brief Start workers until there is one for each stripe but the first
+ *
+ * Called with decode_mutex held, so the generation cannot change meanwhile.
+ *
+ * @return Number of workers, fewer than asked for if a thread could not be started
+ */
+static uint32_t _uvc_mjpeg_pool_grow(struct uvc_mjpeg_pool *pool, uint32_t num_workers) {
+  while (pool->num_workers < num_workers) {
+    struct _uvc_mjpeg_worker *worker = &pool->workers[pool->num_workers];
+
+    worker->pool = pool;
+    worker->index = pool->num_workers + 1;
+    worker->generation = pool->generation;
+    if (pthread_create(&worker->thread, NULL, _uvc_mjpeg_pool_worker, worker) != 0)
+      break;
+    pool->num_workers++;
+  }
+
+  return pool->num_workers < num_workers ? pool->num_workers : num_workers;
+}
+
+/** @internal
+ * @brief Build the stand-alone JPEG for intervals [first, last) of a frame
+ *
+ * The frame header is copied with its height patched to the stripe height, and the
+ * restart markers are renumbered so that the stripe's first one is RST0. The JPEG is
+ * built into the stripe's buffer of the pool, grown if needed.
+ */
+static uvc_error_t _uvc_mjpeg_build_stripe(const uint8_t *data,
+    const struct _uvc_mjpeg_layout *layout, uint32_t first, uint32_t last,
+    uint32_t rows, struct uvc_mjpeg_pool *pool, uint32_t s,
+    struct _uvc_mjpeg_stripe *stripe) {
+  size_t bytes = layout->scan_offset + 2;
+  uint8_t *p;
+  uint32_t k;
+
+  for (k = first; k < last; k++)
+    bytes += layout->interval_end[k] - layout->interval_start[k] + 2;
+
+  if (bytes > pool->jpeg_capacity[s]) {
+    p = realloc(pool->jpeg[s], bytes);
+    if (!p)
+      return UVC_ERROR_NO_MEM;
+    pool->jpeg[s] = p;
+    pool->jpeg_capacity[s] = bytes;
+  }
+  stripe->jpeg = pool->jpeg[s];
+
+  p = stripe->jpeg;
+  memcpy(p, data, layout->scan_offset);
+  p[layout->sof_offset + 5] = (rows >> 8) & 0xff;
+  p[layout->sof_offset + 6] = rows & 0xff;
+  p += layout->scan_offset;
+
+  for (k = first; k < last; k++) {
+    size_t n = layout->interval_end[k] - layout->interval_start[k];
+    memcpy(p, data + layout->interval_start[k], n);
+    p += n;
+    if (k + 1 < last) {
+      p[0] = 0xff;
+      p[1] = 0xd0 + ((k - first) & 7);
+      p += 2;
+    }
+  }
+
+  p[0] = 0xff;
+  p[1] = 0xd9;
+  stripe->jpeg_bytes = p + 2 - stripe->jpeg;
+
+  return UVC_SUCCESS;
+}
+
+/** @internal
+ * @brief Decode an MJPEG frame, splitting it into stripes at its restart markers
+ *
+ * Each stripe is decoded by a worker of the device's stripe pool directly into its
+ * rows of the output buffer, or passed row by row to the row callback of rows; the
+ * calling thread decodes the first stripe. With rows, only the restart intervals
+ * covering its region are decoded. Frames without usable restart markers, or not
+ * from an open device, are decoded on the calling thread alone.
+ *
+ * Chroma that is subsampled vertically (4:2:0) is upsampled without libjpeg's
+ * smoothing when a frame is split, as smoothing would read across the stripe
+ * boundaries. Such frames differ slightly from the single-threaded output, by at
+ * most the difference between smoothed and replicated chroma.
+ */
+static uvc_error_t _uvc_mjpeg_decode_threaded(uvc_frame_t *in, enum uvc_frame_format format,
+    uint8_t *dst, size_t step, int num_threads, const struct _uvc_mjpeg_rows *rows) {
+  struct uvc_mjpeg_pool *pool = in->source ? in->source->mjpeg_pool : NULL;
+  struct _uvc_mjpeg_layout layout;
+  struct _uvc_mjpeg_stripe stripes[UVC_MJPEG_MAX_STRIPES];
+  uint32_t num_stripes = 0, num_workers, s, interval_rows, first_interval, end_interval;
+  uvc_error_t ret = UVC_SUCCESS;
+
+  UVC_PROBE3(mjpeg_decode_start, in->sequence, in->data_bytes, num_threads);
+
+  if (num_threads > 1 && pool) {
+    pthread_mutex_lock(&pool->decode_mutex);
+    /* frames whose header does not match the stream are left to libjpeg alone */
+    if (_uvc_mjpeg_parse_layout(in->data, in->data_bytes, &layout, pool) &&
+        layout.width == in->width && layout.height == in->height)
+      goto striped;
+    pthread_mutex_unlock(&pool->decode_mutex);
+  }
+
+  ret = _uvc_mjpeg_decode(in->data, in->data_bytes, format, dst, step, 1, rows);
+  UVC_PROBE3(mjpeg_decode_done, in->sequence, 1, ret);
+  return ret;
+
+striped:
+  memset(stripes, 0, sizeof(stripes));
+  interval_rows = layout.rows_per_interval * layout.mcu_height;
+  first_interval = 0;
+  end_interval = layout.num_intervals;
+  if (rows) {
+    first_interval = rows->y / interval_rows;
+    end_interval = (rows->y + rows->height + interval_rows - 1) / interval_rows;
+    if (end_interval > layout.num_intervals)
+      end_interval = layout.num_intervals;
+  }
+
+  num_stripes = num_threads;
+  if (num_stripes > UVC_MJPEG_MAX_STRIPES)
+    num_stripes = UVC_MJPEG_MAX_STRIPES;
+  if (num_stripes > end_interval - first_interval)
+    num_stripes = end_interval - first_interval;
+
+  for (s = 0; s < num_stripes; s++) {
+    uint32_t first = first_interval + s * (end_interval - first_interval) / num_stripes;
+    uint32_t last = first_interval + (s + 1) * (end_interval - first_interval) / num_stripes;
+    uint32_t first_row = first * interval_rows;
+    uint32_t last_row = last * interval_rows;
+
+    if (last_row > layout.height)
+      last_row = layout.height;
+
+    stripes[s].format = format;
+    stripes[s].dst = dst ? dst + first_row * step : NULL;
+    stripes[s].step = step;
+    if (rows) {
+      stripes[s].rows = *rows;
+      stripes[s].rows.stripe = s;
+      stripes[s].rows.first_row = first_row;
+    }
+    /* smoothed vertical upsampling would read across the stripe boundaries */
+    stripes[s].fancy_upsampling = !layout.vsub;
+
+    ret = _uvc_mjpeg_build_stripe(in->data, &layout, first, last, last_row - first_row,
+                                  pool, s, &stripes[s]);
+    if (ret != UVC_SUCCESS)
+      goto done;
+  }
+
+  /* stripes beyond the workers that could be started are decoded here */
+  num_workers = num_stripes > 1 ? _uvc_mjpeg_pool_grow(pool, num_stripes - 1) : 0;
+  if (num_workers > 0) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->stripes = stripes;
+    pool->num_stripes = num_workers + 1;
+    pool->pending = num_workers;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+  }
+
+  _uvc_mjpeg_decode_stripe(&stripes[0]);
+  for (s = num_workers + 1; s < num_stripes; s++)
+    _uvc_mjpeg_decode_stripe(&stripes[s]);
+
+  if (num_workers > 0) {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->pending > 0)
+      pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    pool->stripes = NULL;
+    pool->num_stripes = 0;
+    pthread_mutex_unlock(&pool->mutex);
+  }
+
+  for (s = 0; s < num_stripes; s++) {
+    if (stripes[s].result != UVC_SUCCESS)
+      ret = stripes[s].result;
+  }
+
+done:
+  pthread_mutex_unlock(&pool->decode_mutex);
+  UVC_PROBE3(mjpeg_decode_done, in->sequence, num_stripes, ret);
+  return ret;
+}
+
+static uvc_error_t uvc_mjpeg_convert_threaded(uvc_frame_t *in, uvc_frame_t *out,
+    int num_threads) {
+  return _uvc_mjpeg_decode_threaded(in, out->frame_format, out->data, out->step, num_threads,
+                                    NULL);
+}
+
+/** @brief Decode a region of an MJPEG frame scanline by scanline
+ * @ingroup frame
+ *
+ * Instead of filling an output frame, each scanline of the region is passed to row_cb,
+ * which can place, crop or accumulate it while it is still in cache. The scanline
+ * starts at column x and holds width pixels. Only the restart intervals covering the
+ * region are decoded and, with libjpeg-turbo, only the iMCU columns covering it.
+ *
+ * With several threads, row_cb is called concurrently for rows of different stripes,
+ * but rows within a stripe are passed in order, from the same thread. Stripes are
+ * numbered from 0 to num_threads - 1 and start on MCU row boundaries, a multiple of
+ * 8 rows.
+ *
+ * @param in MJPEG frame
+ * @param format Scanline format, UVC_FRAME_FORMAT_RGB or UVC_FRAME_FORMAT_GRAY8
+ * @param num_threads Maximum number of threads to decode with, including the caller
+ * @param x First column of the region
+ * @param y First row of the region
+ * @param width Width of the region
+ * @param height Height of the region
+ * @param row_cb Function receiving each scanline
+ * @param user_ptr User pointer passed to row_cb
+ */
+uvc_error_t uvc_mjpeg_decode_region(uvc_frame_t *in, enum uvc_frame_format format,
+    int num_threads, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+    uvc_mjpeg_row_callback_t *row_cb, void *user_ptr) {
+  struct _uvc_mjpeg_rows rows;
+
+  if (in->frame_format != UVC_FRAME_FORMAT_MJPEG || !row_cb)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (format != UVC_FRAME_FORMAT_RGB && format != UVC_FRAME_FORMAT_GRAY8)
+    return UVC_ERROR_NOT_SUPPORTED;
+
+  if (width == 0 || height == 0 || x >= in->width || y >= in->height ||
+      width > in->width - x || height > in->height - y)
+    return UVC_ERROR_INVALID_PARAM;
+
+  memset(&rows, 0, sizeof(rows));
+  rows.cb = row_cb;
+  rows.user_ptr = user_ptr;
+  rows.frame_width = in->width;
+  rows.x = x;
+  rows.width = width;
+  rows.y = y;
+  rows.height = height;
+
+  return _uvc_mjpeg_decode_threaded(in, format, NULL, 0, num_threads, &rows);
+}
+
+/** @brief Decode an MJPEG frame scanline by scanline
+ * @ingroup frame
+ *
+ * @see uvc_mjpeg_decode_region
+ *
+ * @param in MJPEG frame
+ * @param format Scanline format, UVC_FRAME_FORMAT_RGB or UVC_FRAME_FORMAT_GRAY8
+ * @param num_threads Maximum number of threads to decode with, including the caller
+ * @param row_cb Function receiving each scanline
+ * @param user_ptr User pointer passed to row_cb
+ */
+uvc_error_t uvc_mjpeg_decode_rows(uvc_frame_t *in, enum uvc_frame_format format,
+    int num_threads, uvc_mjpeg_row_callback_t *row_cb, void *user_ptr) {
+  return uvc_mjpeg_decode_region(in, format, num_threads, 0, 0, in->width, in->height,
+                                 row_cb, user_ptr);
+}
+
 /** @brief Convert an MJPEG frame to RGB
  * @ingroup frame
  *
@@ -178,6 +972,26 @@ fail:
  * @param out RGB frame
  */
 uvc_error_t uvc_mjpeg2rgb(uvc_frame_t *in, uvc_frame_t *out) {
+  return uvc_mjpeg2rgb_threaded(in, out, 1);
+}
+
+/** @brief Convert an MJPEG frame to RGB using several threads
+ * @ingroup frame
+ *
+ * Frames with restart markers at MCU row boundaries are split into horizontal stripes
+ * that are decoded concurrently into the output frame, by threads kept with the
+ * device that streamed the frame. Frames of a device are therefore decoded one at a
+ * time, and must be converted before the device is closed. Other frames are decoded
+ * on the calling thread.
+ *
+ * Split frames with vertically subsampled chroma (4:2:0) are decoded without smoothed
+ * chroma upsampling, so they differ slightly from frames decoded on one thread.
+ *
+ * @param in MJPEG frame
+ * @param out RGB frame
+ * @param num_threads Maximum number of threads to decode with, including the caller
+ */
+uvc_error_t uvc_mjpeg2rgb_threaded(uvc_frame_t *in, uvc_frame_t *out, int num_threads) {
   if (in->frame_format != UVC_FRAME_FORMAT_MJPEG)
     return UVC_ERROR_INVALID_PARAM;
 
@@ -191,9 +1005,12 @@ uvc_error_t uvc_mjpeg2rgb(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->transfer_time_finished = in->transfer_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
-  return uvc_mjpeg_convert(in, out);
+  return uvc_mjpeg_convert_threaded(in, out, num_threads);
 }
 
 /** @brief Convert an MJPEG frame to GRAY8
@@ -203,6 +1020,19 @@ uvc_error_t uvc_mjpeg2rgb(uvc_frame_t *in, uvc_frame_t *out) {
  * @param out GRAY8 frame
  */
 uvc_error_t uvc_mjpeg2gray(uvc_frame_t *in, uvc_frame_t *out) {
+  return uvc_mjpeg2gray_threaded(in, out, 1);
+}
+
+/** @brief Convert an MJPEG frame to GRAY8 using several threads
+ * @ingroup frame
+ *
+ * @see uvc_mjpeg2rgb_threaded
+ *
+ * @param in MJPEG frame
+ * @param out GRAY8 frame
+ * @param num_threads Maximum number of threads to decode with, including the caller
+ */
+uvc_error_t uvc_mjpeg2gray_threaded(uvc_frame_t *in, uvc_frame_t *out, int num_threads) {
   if (in->frame_format != UVC_FRAME_FORMAT_MJPEG)
     return UVC_ERROR_INVALID_PARAM;
 
@@ -216,7 +1046,53 @@ uvc_error_t uvc_mjpeg2gray(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->transfer_time_finished = in->transfer_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
+  out->source = in->source;
+
+  return uvc_mjpeg_convert_threaded(in, out, num_threads);
+}
+
+/** @brief Convert an MJPEG frame to packed UYVY (YUV 4:2:2)
+ * @ingroup frame
+ *
+ * The luma and chroma planes are interleaved as decoded, without conversion to RGB.
+ *
+ * @param in MJPEG frame
+ * @param out UYVY frame
+ */
+uvc_error_t uvc_mjpeg2uyvy(uvc_frame_t *in, uvc_frame_t *out) {
+  return uvc_mjpeg2uyvy_threaded(in, out, 1);
+}
+
+/** @brief Convert an MJPEG frame to packed UYVY (YUV 4:2:2) using several threads
+ * @ingroup frame
+ *
+ * @see uvc_mjpeg2rgb_threaded
+ *
+ * @param in MJPEG frame
+ * @param out UYVY frame
+ * @param num_threads Maximum number of threads to decode with, including the caller
+ */
+uvc_error_t uvc_mjpeg2uyvy_threaded(uvc_frame_t *in, uvc_frame_t *out, int num_threads) {
+  if (in->frame_format != UVC_FRAME_FORMAT_MJPEG)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (uvc_ensure_frame_size(out, in->width * in->height * 2) < 0)
+    return UVC_ERROR_NO_MEM;
+
+  out->width = in->width;
+  out->height = in->height;
+  out->frame_format = UVC_FRAME_FORMAT_UYVY;
+  out->step = in->width * 2;
+  out->sequence = in->sequence;
+  out->capture_time = in->capture_time;
+  out->capture_time_finished = in->capture_time_finished;
+  out->transfer_time_finished = in->transfer_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
-  return uvc_mjpeg_convert(in, out);
+  return uvc_mjpeg_convert_threaded(in, out, num_threads);
 }
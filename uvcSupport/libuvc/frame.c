@@ -38,6 +38,12 @@
 #include "libuvc/libuvc.h"
 #include "libuvc/libuvc_internal.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 /** @internal */
 uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes) {
   if (frame->library_owns_data) {
@@ -122,6 +128,9 @@ uvc_error_t uvc_duplicate_frame(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->transfer_time_finished = in->transfer_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   memcpy(out->data, in->data, in->data_bytes);
@@ -185,6 +194,9 @@ uvc_error_t uvc_yuyv2rgb(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->transfer_time_finished = in->transfer_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   uint8_t *pyuv = in->data;
@@ -236,6 +248,9 @@ uvc_error_t uvc_yuyv2bgr(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->transfer_time_finished = in->transfer_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   uint8_t *pyuv = in->data;
@@ -252,13 +267,90 @@ uvc_error_t uvc_yuyv2bgr(uvc_frame_t *in, uvc_frame_t *out) {
   return UVC_SUCCESS;
 }
 
-#define IYUYV2Y(pyuv, py) { \
-    (py)[0] = (pyuv[0]); \
+/** @internal
+ * @brief Copy every other byte of a packed 4:2:2 buffer
+ *
+ * Deinterleaves the luma of @p num_pixels YUYV (@p y_offset 0) or UYVY (@p y_offset 1) pixels,
+ * 16 or 32 at a time with SSE2 or NEON where the compiler targets them.
+ */
+static void _uvc_extract_y(const uint8_t *pyuv, uint8_t *py, size_t num_pixels, int y_offset) {
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+
+  for (; i + 16 <= num_pixels; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *) (pyuv + 2 * i));
+    __m128i b = _mm_loadu_si128((const __m128i *) (pyuv + 2 * i + 16));
+
+    if (y_offset) {
+      a = _mm_srli_epi16(a, 8);
+      b = _mm_srli_epi16(b, 8);
+    } else {
+      a = _mm_and_si128(a, low_bytes);
+      b = _mm_and_si128(b, low_bytes);
     }
+    _mm_storeu_si128((__m128i *) (py + i), _mm_packus_epi16(a, b));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 32 <= num_pixels; i += 32) {
+    uint8x16x2_t lo = vld2q_u8(pyuv + 2 * i);
+    uint8x16x2_t hi = vld2q_u8(pyuv + 2 * i + 32);
+
+    vst1q_u8(py + i, lo.val[y_offset]);
+    vst1q_u8(py + i + 16, hi.val[y_offset]);
+  }
+#endif
+
+  for (; i < num_pixels; i++)
+    py[i] = pyuv[2 * i + y_offset];
+}
+
+/** @internal
+ * @brief Shared body of uvc_yuyv2y and uvc_uyvy2y
+ *
+ * Input rows are in->step bytes apart, or packed if the step is unset.
+ */
+static uvc_error_t _uvc_packed422_to_y(uvc_frame_t *in, uvc_frame_t *out, int y_offset) {
+  size_t num_pixels = in->width * in->height;
+  size_t in_step = in->step ? in->step : in->width * 2;
+  uint32_t y;
+
+  if (in_step < in->width * 2 ||
+      (in->height > 0 && in->data_bytes < in_step * (in->height - 1) + in->width * 2))
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (uvc_ensure_frame_size(out, num_pixels) < 0)
+    return UVC_ERROR_NO_MEM;
+
+  out->width = in->width;
+  out->height = in->height;
+  out->frame_format = UVC_FRAME_FORMAT_GRAY8;
+  out->step = in->width;
+  out->sequence = in->sequence;
+  out->capture_time = in->capture_time;
+  out->capture_time_finished = in->capture_time_finished;
+  out->transfer_time_finished = in->transfer_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
+  out->source = in->source;
+
+  if (in_step == in->width * 2) {
+    _uvc_extract_y(in->data, out->data, num_pixels, y_offset);
+  } else {
+    for (y = 0; y < in->height; y++)
+      _uvc_extract_y((const uint8_t *) in->data + y * in_step,
+                     (uint8_t *) out->data + y * in->width, in->width, y_offset);
+  }
+
+  return UVC_SUCCESS;
+}
 
 /** @brief Convert a frame from YUYV to Y (GRAY8)
  * @ingroup frame
  *
+ * Input rows may be padded, in->step bytes apart.
+ *
  * @param in YUYV frame
  * @param out GRAY8 frame
  */
@@ -266,27 +358,74 @@ uvc_error_t uvc_yuyv2y(uvc_frame_t *in, uvc_frame_t *out) {
   if (in->frame_format != UVC_FRAME_FORMAT_YUYV)
     return UVC_ERROR_INVALID_PARAM;
 
-  if (uvc_ensure_frame_size(out, in->width * in->height) < 0)
+  return _uvc_packed422_to_y(in, out, 0);
+}
+
+/** @brief Convert a frame from UYVY to Y (GRAY8)
+ * @ingroup frame
+ *
+ * Input rows may be padded, in->step bytes apart.
+ *
+ * @param in UYVY frame
+ * @param out GRAY8 frame
+ */
+uvc_error_t uvc_uyvy2y(uvc_frame_t *in, uvc_frame_t *out) {
+  if (in->frame_format != UVC_FRAME_FORMAT_UYVY)
+    return UVC_ERROR_INVALID_PARAM;
+
+  return _uvc_packed422_to_y(in, out, 1);
+}
+
+/** @brief Convert a frame from YUYV to UYVY
+ * @ingroup frame
+ *
+ * Swaps every luma byte with the chroma byte that follows it. Input rows may be
+ * padded, in->step bytes apart.
+ *
+ * @param in YUYV frame
+ * @param out UYVY frame
+ */
+uvc_error_t uvc_yuyv2uyvy(uvc_frame_t *in, uvc_frame_t *out) {
+  size_t row_bytes = in->width * 2;
+  size_t in_step = in->step ? in->step : row_bytes;
+  uint32_t y;
+
+  if (in->frame_format != UVC_FRAME_FORMAT_YUYV)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (in_step < row_bytes ||
+      (in->height > 0 && in->data_bytes < in_step * (in->height - 1) + row_bytes))
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (uvc_ensure_frame_size(out, in->width * in->height * 2) < 0)
     return UVC_ERROR_NO_MEM;
 
   out->width = in->width;
   out->height = in->height;
-  out->frame_format = UVC_FRAME_FORMAT_GRAY8;
-  out->step = in->width;
+  out->frame_format = UVC_FRAME_FORMAT_UYVY;
+  out->step = in->width * 2;
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->transfer_time_finished = in->transfer_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
-  uint8_t *pyuv = in->data;
-  uint8_t *py = out->data;
-  uint8_t *py_end = py + out->data_bytes;
+  for (y = 0; y < in->height; y++) {
+    uint8_t *pyuv = (uint8_t *) in->data + y * in_step;
+    uint8_t *puyvy = (uint8_t *) out->data + y * row_bytes;
+    uint8_t *puyvy_end = puyvy + row_bytes;
 
-  while (py < py_end) {
-    IYUYV2Y(pyuv, py);
+    while (puyvy < puyvy_end) {
+      puyvy[0] = pyuv[1];
+      puyvy[1] = pyuv[0];
+      puyvy[2] = pyuv[3];
+      puyvy[3] = pyuv[2];
 
-    py += 1;
-    pyuv += 2;
+      puyvy += 4;
+      pyuv += 4;
+    }
   }
 
   return UVC_SUCCESS;
@@ -316,6 +455,9 @@ uvc_error_t uvc_yuyv2uv(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->transfer_time_finished = in->transfer_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   uint8_t *pyuv = in->data;
@@ -366,6 +508,9 @@ uvc_error_t uvc_uyvy2rgb(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->transfer_time_finished = in->transfer_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   uint8_t *pyuv = in->data;
@@ -416,6 +561,9 @@ uvc_error_t uvc_uyvy2bgr(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->transfer_time_finished = in->transfer_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   uint8_t *pyuv = in->data;
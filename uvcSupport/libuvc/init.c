@@ -85,9 +85,14 @@ YUV stream from a UVC device such as a standard webcam.
  */
 void *_uvc_handle_events(void *arg) {
   uvc_context_t *ctx = (uvc_context_t *) arg;
+  uint64_t last_cpu_ns = 0, cpu_ns;
 
-  while (!ctx->kill_handler_thread)
+  while (!ctx->kill_handler_thread) {
     libusb_handle_events_completed(ctx->usb_ctx, &ctx->kill_handler_thread);
+    cpu_ns = _uvc_thread_cpu_ns();
+    __atomic_fetch_add(&ctx->event_cpu_ns, cpu_ns - last_cpu_ns, __ATOMIC_RELAXED);
+    last_cpu_ns = cpu_ns;
+  }
   return NULL;
 }
 
@@ -87,6 +87,16 @@ enum uvc_frame_format {
   UVC_FRAME_FORMAT_NV12,
   /** YUV: P010 */
   UVC_FRAME_FORMAT_P010,
+  /** Greyscale, 10 or 12 significant bits in the low bits of a little endian 16-bit word */
+  UVC_FRAME_FORMAT_Y10,
+  UVC_FRAME_FORMAT_Y12,
+  /** Greyscale, 10 or 12 bits packed as MIPI CSI-2 RAW10 (4 pixels in 5 bytes) or RAW12
+   * (2 pixels in 3 bytes)
+   */
+  UVC_FRAME_FORMAT_Y10P,
+  UVC_FRAME_FORMAT_Y12P,
+  /** Any of the 8-bit raw colour mosaic formats */
+  UVC_FRAME_FORMAT_BAYER8,
   /** Number of formats understood */
   UVC_FRAME_FORMAT_COUNT,
 };
@@ -471,6 +481,14 @@ typedef struct uvc_frame {
   struct timeval capture_time;
   /** Estimate of system time when the device finished receiving the image */
   struct timespec capture_time_finished;
+  /** Monotonic time when the USB transfer completing the image was received */
+  struct timespec transfer_time_finished;
+  /** Presentation time stamp from the payload headers, in device clock ticks,
+   * or 0 if the device does not send one */
+  uint32_t pts;
+  /** Source time clock of the last payload header carrying a source clock
+   * reference, in device clock ticks, or 0 if the device does not send one */
+  uint32_t scr;
   /** Handle on the device that produced the image.
    * @warning You must not call any uvc_* functions during a callback. */
   uvc_device_handle_t *source;
@@ -492,6 +510,14 @@ typedef struct uvc_frame {
  */
 typedef void(uvc_frame_callback_t)(struct uvc_frame *frame, void *user_ptr);
 
+/** A callback function to receive the scanlines of a decoded MJPEG frame, with the
+ * index of the stripe decoding them
+ * @ingroup frame
+ * @see uvc_mjpeg_decode_rows
+ */
+typedef void(uvc_mjpeg_row_callback_t)(uint32_t row, const uint8_t *scanline, int stripe,
+                                       void *user_ptr);
+
 /** Streaming mode, includes all information needed to select stream
  * @ingroup streaming
  */
@@ -597,6 +623,13 @@ uvc_error_t uvc_get_stream_ctrl_format_size(
     int fps
     );
 
+enum uvc_frame_format uvc_get_stream_ctrl_frame_format(
+    uvc_device_handle_t *devh,
+    uvc_stream_ctrl_t *ctrl);
+
+enum uvc_frame_format uvc_get_format_desc_frame_format(
+    const uvc_format_desc_t *format_desc);
+
 uvc_error_t uvc_get_still_ctrl_format_size(
     uvc_device_handle_t *devh,
     uvc_stream_ctrl_t *ctrl,
@@ -632,6 +665,11 @@ uvc_error_t uvc_start_iso_streaming(
 
 void uvc_stop_streaming(uvc_device_handle_t *devh);
 
+void uvc_get_stream_counters(uvc_device_handle_t *devh, uint64_t *payload_bytes,
+    uint64_t *frames_completed);
+void uvc_get_thread_cpu(uvc_device_handle_t *devh, uint64_t *event_ns, uint64_t *callback_ns,
+    uint64_t *decode_ns);
+
 uvc_error_t uvc_stream_open_ctrl(uvc_device_handle_t *devh, uvc_stream_handle_t **strmh, uvc_stream_ctrl_t *ctrl);
 uvc_error_t uvc_stream_ctrl(uvc_stream_handle_t *strmh, uvc_stream_ctrl_t *ctrl);
 uvc_error_t uvc_stream_start(uvc_stream_handle_t *strmh,
@@ -798,10 +836,21 @@ uvc_error_t uvc_any2bgr(uvc_frame_t *in, uvc_frame_t *out);
 
 uvc_error_t uvc_yuyv2y(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_yuyv2uv(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_yuyv2uyvy(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_uyvy2y(uvc_frame_t *in, uvc_frame_t *out);
 
 #ifdef LIBUVC_HAS_JPEG
 uvc_error_t uvc_mjpeg2rgb(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_mjpeg2gray(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_mjpeg2rgb_threaded(uvc_frame_t *in, uvc_frame_t *out, int num_threads);
+uvc_error_t uvc_mjpeg2gray_threaded(uvc_frame_t *in, uvc_frame_t *out, int num_threads);
+uvc_error_t uvc_mjpeg2uyvy(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_mjpeg2uyvy_threaded(uvc_frame_t *in, uvc_frame_t *out, int num_threads);
+uvc_error_t uvc_mjpeg_decode_rows(uvc_frame_t *in, enum uvc_frame_format format,
+    int num_threads, uvc_mjpeg_row_callback_t *row_cb, void *user_ptr);
+uvc_error_t uvc_mjpeg_decode_region(uvc_frame_t *in, enum uvc_frame_format format,
+    int num_threads, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+    uvc_mjpeg_row_callback_t *row_cb, void *user_ptr);
 #endif
 
 #ifdef __cplusplus
@@ -11,6 +11,7 @@
 #include <string.h>
 #include <pthread.h>
 #include <signal.h>
+#include <time.h>
 #include <libusb-1.0/libusb.h>
 #include "utlist.h"
 
@@ -69,6 +70,19 @@
 #define UVC_EXIT(code)
 #endif
 
+/* Static tracepoints (USDT) of the libuvc provider, for perf and bpftrace. Compiled in when
+ * UVC_USDT is defined, each one is a single nop until a tracer attaches to it. */
+#ifdef UVC_USDT
+#include <sys/sdt.h>
+#define UVC_PROBE1(name, a) DTRACE_PROBE1(libuvc, name, a)
+#define UVC_PROBE2(name, a, b) DTRACE_PROBE2(libuvc, name, a, b)
+#define UVC_PROBE3(name, a, b, c) DTRACE_PROBE3(libuvc, name, a, b, c)
+#else
+#define UVC_PROBE1(name, a)
+#define UVC_PROBE2(name, a, b)
+#define UVC_PROBE3(name, a, b, c)
+#endif
+
 /* http://stackoverflow.com/questions/19452971/array-size-macro-that-rejects-pointers */
 #define IS_INDEXABLE(arg) (sizeof(arg[0]))
 #define IS_ARRAY(arg) (IS_INDEXABLE(arg) && (((void *) &arg) == ((void *) arg)))
@@ -262,6 +276,8 @@ struct uvc_stream_handle {
   struct uvc_frame frame;
   enum uvc_frame_format frame_format;
   struct timespec capture_time_finished;
+  /* completion time of the transfer being processed, and of the one completing the held frame */
+  struct timespec transfer_time, transfer_time_finished;
 
   /* raw metadata buffer if available */
   uint8_t *meta_outbuf, *meta_holdbuf;
@@ -291,6 +307,16 @@ struct uvc_device_handle {
   /** Whether the camera is an iSight that sends one header per frame */
   uint8_t is_isight;
   uint32_t claimed;
+  /** Payload bytes received and frames completed by all streams since the device was opened.
+   * Only written by the USB event thread, read with uvc_get_stream_counters */
+  uint64_t payload_bytes;
+  uint64_t frames_completed;
+  /** CPU time of the stream callback threads, and of the threads decoding stripes of the
+   * device's MJPEG frames, in ns. Read with uvc_get_thread_cpu */
+  uint64_t callback_cpu_ns;
+  uint64_t decode_cpu_ns;
+  /** Threads decoding stripes of the device's MJPEG frames, see frame-mjpeg.c */
+  struct uvc_mjpeg_pool *mjpeg_pool;
 };
 
 /** Context within which we communicate with devices */
@@ -303,6 +329,8 @@ struct uvc_context {
   uvc_device_handle_t *open_devices;
   pthread_t handler_thread;
   int kill_handler_thread;
+  /** CPU time of the event handler thread, in ns */
+  uint64_t event_cpu_ns;
 };
 
 uvc_error_t uvc_query_stream_ctrl(
@@ -312,6 +340,18 @@ uvc_error_t uvc_query_stream_ctrl(
     enum uvc_req_code req);
 
 void uvc_start_handler_thread(uvc_context_t *ctx);
+struct uvc_mjpeg_pool *_uvc_mjpeg_pool_create(uvc_device_handle_t *devh);
+void _uvc_mjpeg_pool_destroy(struct uvc_mjpeg_pool *pool);
+
+/** @internal
+ * @brief CPU time used by the calling thread, in ns
+ */
+static inline uint64_t _uvc_thread_cpu_ns(void) {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    return 0;
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 uvc_error_t uvc_claim_if(uvc_device_handle_t *devh, int idx);
 uvc_error_t uvc_release_if(uvc_device_handle_t *devh, int idx);
 
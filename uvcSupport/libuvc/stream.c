@@ -103,10 +103,12 @@ struct format_table_entry *_get_format_entry(enum uvc_frame_format format) {
     ABS_FMT(UVC_FRAME_FORMAT_ANY, 2,
       {UVC_FRAME_FORMAT_UNCOMPRESSED, UVC_FRAME_FORMAT_COMPRESSED})
 
-    ABS_FMT(UVC_FRAME_FORMAT_UNCOMPRESSED, 8,
+    ABS_FMT(UVC_FRAME_FORMAT_UNCOMPRESSED, 13,
       {UVC_FRAME_FORMAT_YUYV, UVC_FRAME_FORMAT_UYVY, UVC_FRAME_FORMAT_GRAY8,
        UVC_FRAME_FORMAT_GRAY16, UVC_FRAME_FORMAT_NV12, UVC_FRAME_FORMAT_P010,
-       UVC_FRAME_FORMAT_BGR, UVC_FRAME_FORMAT_RGB})
+       UVC_FRAME_FORMAT_BGR, UVC_FRAME_FORMAT_RGB, UVC_FRAME_FORMAT_Y10,
+       UVC_FRAME_FORMAT_Y12, UVC_FRAME_FORMAT_Y10P, UVC_FRAME_FORMAT_Y12P,
+       UVC_FRAME_FORMAT_BAYER8})
     FMT(UVC_FRAME_FORMAT_YUYV,
       {'Y',  'U',  'Y',  '2', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71})
     FMT(UVC_FRAME_FORMAT_UYVY,
@@ -115,6 +117,14 @@ struct format_table_entry *_get_format_entry(enum uvc_frame_format format) {
       {'Y',  '8',  '0',  '0', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71})
     FMT(UVC_FRAME_FORMAT_GRAY16,
       {'Y',  '1',  '6',  ' ', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71})
+    FMT(UVC_FRAME_FORMAT_Y10,
+      {'Y',  '1',  '0',  ' ', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71})
+    FMT(UVC_FRAME_FORMAT_Y12,
+      {'Y',  '1',  '2',  ' ', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71})
+    FMT(UVC_FRAME_FORMAT_Y10P,
+      {'Y',  '1',  '0',  'P', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71})
+    FMT(UVC_FRAME_FORMAT_Y12P,
+      {'Y',  '1',  '2',  'P', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71})
     FMT(UVC_FRAME_FORMAT_NV12,
       {'N',  'V',  '1',  '2', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71})
     FMT(UVC_FRAME_FORMAT_P010,
@@ -123,6 +133,9 @@ struct format_table_entry *_get_format_entry(enum uvc_frame_format format) {
       {0x7d, 0xeb, 0x36, 0xe4, 0x4f, 0x52, 0xce, 0x11, 0x9f, 0x53, 0x00, 0x20, 0xaf, 0x0b, 0xa7, 0x70})
     FMT(UVC_FRAME_FORMAT_RGB,
         {0x7e, 0xeb, 0x36, 0xe4, 0x4f, 0x52, 0xce, 0x11, 0x9f, 0x53, 0x00, 0x20, 0xaf, 0x0b, 0xa7, 0x70})
+    ABS_FMT(UVC_FRAME_FORMAT_BAYER8, 6,
+      {UVC_FRAME_FORMAT_BY8, UVC_FRAME_FORMAT_BA81, UVC_FRAME_FORMAT_SGRBG8,
+       UVC_FRAME_FORMAT_SGBRG8, UVC_FRAME_FORMAT_SRGGB8, UVC_FRAME_FORMAT_SBGGR8})
     FMT(UVC_FRAME_FORMAT_BY8,
       {'B',  'Y',  '8',  ' ', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71})
     FMT(UVC_FRAME_FORMAT_BA81,
@@ -592,6 +605,42 @@ uvc_error_t uvc_get_still_ctrl_format_size(
     return uvc_probe_still_ctrl(devh, still_ctrl);
 }
 
+/** Get the concrete frame format selected by a negotiated control block
+ * @ingroup streaming
+ *
+ * Streams requested as UVC_FRAME_FORMAT_UNCOMPRESSED (or ANY) are resolved to the format whose
+ * GUID the device advertises for the chosen format descriptor, which is also the format set on
+ * the frames handed to the stream callback.
+ *
+ * @param[in] devh Device handle
+ * @param[in] ctrl Control block, as filled by uvc_get_stream_ctrl_format_size
+ * @return Frame format, or UVC_FRAME_FORMAT_UNKNOWN if the descriptor or its GUID is unknown
+ */
+enum uvc_frame_format uvc_get_stream_ctrl_frame_format(
+    uvc_device_handle_t *devh,
+    uvc_stream_ctrl_t *ctrl) {
+  uvc_frame_desc_t *frame_desc = uvc_find_frame_desc(devh, ctrl->bFormatIndex, ctrl->bFrameIndex);
+
+  if (!frame_desc)
+    return UVC_FRAME_FORMAT_UNKNOWN;
+
+  return uvc_get_format_desc_frame_format(frame_desc->parent);
+}
+
+/** Get the concrete frame format of a format descriptor
+ * @ingroup streaming
+ *
+ * @param[in] format_desc Format descriptor, as listed by uvc_get_format_descs
+ * @return Frame format, or UVC_FRAME_FORMAT_UNKNOWN if the GUID is unknown
+ */
+enum uvc_frame_format uvc_get_format_desc_frame_format(
+    const uvc_format_desc_t *format_desc) {
+  uint8_t guid[16];
+
+  memcpy(guid, format_desc->guidFormat, sizeof(guid));
+  return uvc_frame_format_for_guid(guid);
+}
+
 static int _uvc_stream_params_negotiated(
   uvc_stream_ctrl_t *required,
   uvc_stream_ctrl_t *actual) {
@@ -657,9 +706,12 @@ uvc_error_t uvc_probe_still_ctrl(
 void _uvc_swap_buffers(uvc_stream_handle_t *strmh) {
   uint8_t *tmp_buf;
 
+  UVC_PROBE2(frame_complete, strmh->seq, strmh->got_bytes);
+
   pthread_mutex_lock(&strmh->cb_mutex);
 
   (void)clock_gettime(CLOCK_MONOTONIC, &strmh->capture_time_finished);
+  strmh->transfer_time_finished = strmh->transfer_time;
 
   /* swap the buffers */
   tmp_buf = strmh->holdbuf;
@@ -669,6 +721,7 @@ void _uvc_swap_buffers(uvc_stream_handle_t *strmh) {
   strmh->hold_last_scr = strmh->last_scr;
   strmh->hold_pts = strmh->pts;
   strmh->hold_seq = strmh->seq;
+  __atomic_fetch_add(&strmh->devh->frames_completed, 1, __ATOMIC_RELAXED);
   
   /* swap metadata buffer */
   tmp_buf = strmh->meta_holdbuf;
@@ -707,10 +760,14 @@ void _uvc_process_payload(uvc_stream_handle_t *strmh, uint8_t *payload, size_t p
     0xde, 0xad, 0xbe, 0xef, 0xde, 0xad, 0xfa, 0xce
   };
 
+  UVC_PROBE3(payload, strmh->seq, payload_len, strmh->got_bytes);
+
   /* ignore empty payload transfers */
   if (payload_len == 0)
     return;
 
+  __atomic_fetch_add(&strmh->devh->payload_bytes, payload_len, __ATOMIC_RELAXED);
+
   /* Certain iSight cameras have strange behavior: They send header
    * information in a packet with no image data, and then the following
    * packets have only image data, with no more headers until the next frame.
@@ -809,6 +866,9 @@ void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer) {
 
   switch (transfer->status) {
   case LIBUSB_TRANSFER_COMPLETED:
+    (void)clock_gettime(CLOCK_MONOTONIC, &strmh->transfer_time);
+    UVC_PROBE3(transfer_completed, strmh->seq, transfer->actual_length,
+               transfer->num_iso_packets);
     if (transfer->num_iso_packets == 0) {
       /* This is a bulk mode transfer, so it just has one payload transfer */
       _uvc_process_payload(strmh, transfer->buffer, transfer->actual_length);
@@ -839,6 +899,7 @@ void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer) {
   case LIBUSB_TRANSFER_NO_DEVICE: {
     int i;
     UVC_DEBUG("not retrying transfer, status = %d", transfer->status);
+    UVC_PROBE2(transfer_failed, strmh->seq, transfer->status);
     pthread_mutex_lock(&strmh->cb_mutex);
 
     /* Mark transfer as deleted. */
@@ -866,6 +927,7 @@ void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer) {
   case LIBUSB_TRANSFER_STALL:
   case LIBUSB_TRANSFER_OVERFLOW:
     UVC_DEBUG("retrying transfer, status = %d", transfer->status);
+    UVC_PROBE2(transfer_failed, strmh->seq, transfer->status);
     break;
   }
   
@@ -1297,6 +1359,7 @@ void *_uvc_user_caller(void *arg) {
   uvc_stream_handle_t *strmh = (uvc_stream_handle_t *) arg;
 
   uint32_t last_seq = 0;
+  uint64_t last_cpu_ns = _uvc_thread_cpu_ns(), cpu_ns;
 
   do {
     pthread_mutex_lock(&strmh->cb_mutex);
@@ -1315,7 +1378,13 @@ void *_uvc_user_caller(void *arg) {
     
     pthread_mutex_unlock(&strmh->cb_mutex);
     
+    UVC_PROBE2(user_callback_start, strmh->frame.sequence, strmh->frame.data_bytes);
     strmh->user_cb(&strmh->frame, strmh->user_ptr);
+    UVC_PROBE1(user_callback_done, strmh->frame.sequence);
+
+    cpu_ns = _uvc_thread_cpu_ns();
+    __atomic_fetch_add(&strmh->devh->callback_cpu_ns, cpu_ns - last_cpu_ns, __ATOMIC_RELAXED);
+    last_cpu_ns = cpu_ns;
   } while(1);
 
   return NULL; // return value ignored
@@ -1355,6 +1424,16 @@ void _uvc_populate_frame(uvc_stream_handle_t *strmh) {
   case UVC_FRAME_FORMAT_P010:
     frame->step = frame->width * 2;
         break;
+  case UVC_FRAME_FORMAT_Y10:
+  case UVC_FRAME_FORMAT_Y12:
+    frame->step = frame->width * 2;
+    break;
+  case UVC_FRAME_FORMAT_Y10P:
+    frame->step = (frame->width + 3) / 4 * 5;
+    break;
+  case UVC_FRAME_FORMAT_Y12P:
+    frame->step = (frame->width + 1) / 2 * 3;
+    break;
   case UVC_FRAME_FORMAT_MJPEG:
     frame->step = 0;
     break;
@@ -1368,6 +1447,10 @@ void _uvc_populate_frame(uvc_stream_handle_t *strmh) {
 
   frame->sequence = strmh->hold_seq;
   frame->capture_time_finished = strmh->capture_time_finished;
+  frame->transfer_time_finished = strmh->transfer_time_finished;
+  frame->pts = strmh->hold_pts;
+  frame->scr = strmh->hold_last_scr;
+  frame->source = strmh->devh;
 
   /* copy the image data from the hold buffer to the frame (unnecessary extra buf?) */
   if (frame->data_bytes < strmh->hold_bytes) {
@@ -1482,6 +1565,41 @@ void uvc_stop_streaming(uvc_device_handle_t *devh) {
   }
 }
 
+/** @brief Get the totals of the streams of a device
+ * @ingroup streaming
+ *
+ * Counts accumulate over all streams since the device was opened, so rates are taken from the
+ * difference between two calls. Safe to call from any thread while streaming.
+ *
+ * @param devh UVC device
+ * @param[out] payload_bytes Bytes of payload received, headers included
+ * @param[out] frames_completed Frames assembled and handed to the stream's consumers
+ */
+void uvc_get_stream_counters(uvc_device_handle_t *devh, uint64_t *payload_bytes,
+    uint64_t *frames_completed) {
+  *payload_bytes = __atomic_load_n(&devh->payload_bytes, __ATOMIC_RELAXED);
+  *frames_completed = __atomic_load_n(&devh->frames_completed, __ATOMIC_RELAXED);
+}
+
+/** @brief Get the CPU time used by the threads libuvc runs for a device
+ * @ingroup streaming
+ *
+ * Times accumulate since the device was opened, so CPU usage is taken from the difference
+ * between two calls. The event thread is shared by the devices of a context, and only runs
+ * if libuvc created the USB context. Safe to call from any thread while streaming.
+ *
+ * @param devh UVC device
+ * @param[out] event_ns CPU time of the USB event handler thread of the device's context
+ * @param[out] callback_ns CPU time of the threads calling the stream callbacks
+ * @param[out] decode_ns CPU time of the extra threads decoding the device's MJPEG frames
+ */
+void uvc_get_thread_cpu(uvc_device_handle_t *devh, uint64_t *event_ns, uint64_t *callback_ns,
+    uint64_t *decode_ns) {
+  *event_ns = __atomic_load_n(&devh->dev->ctx->event_cpu_ns, __ATOMIC_RELAXED);
+  *callback_ns = __atomic_load_n(&devh->callback_cpu_ns, __ATOMIC_RELAXED);
+  *decode_ns = __atomic_load_n(&devh->decode_cpu_ns, __ATOMIC_RELAXED);
+}
+
 /** @brief Stop stream.
  * @ingroup streaming
  *